@@ -0,0 +1,11 @@
+<?php
+
+// a large response, written a block at a time, for seeing how clients that read it slowly are served
+header("Content-Type: application/octet-stream");
+$megabytes = isset($_GET["megabytes"]) ? (int) $_GET["megabytes"] : 20;
+$block = str_repeat("0123456789abcdef", 65536);
+for ($i = 0; $i < $megabytes; $i++)
+{
+    echo $block;
+    flush();
+}
@@ -16,50 +16,820 @@
 #define LimitRequestFieldSize 4094
 #define LimitRequestLine 8190
 
+// most octets a request's headers can span without crossing one of those limits
+#define REQUEST (LimitRequestLine + 2 + LimitRequestFields * (LimitRequestFieldSize + 2) + 2)
+
 // number of octets for buffered reads
 #define OCTETS 512
 
+// most octets of responses to pipelined requests batched before writing them
+#define BATCH 65536
+
+// most parts (headers, bodies) of responses written at once
+#define SEGMENTS 64
+
+// most octets of a file read into a response at a time (with io_uring), each window sent before the next is read
+#define WINDOW 262144
+
+// number of buckets in cache of files (a power of 2), and most octets a file can have to be cached
+#define BUCKETS 1024
+#define CACHEABLE 1048576
+
+// number of slots in cache of paths found missing (a power of 2), most octets such a path can have to be cached,
+// and seconds for which it's cached (in case it appears where inotify can't see)
+#define ABSENCES 4096
+#define ABSENT 1024
+#define FORGET 10
+
+// most octets a file's validators (its ETag and Last-Modified headers, along with any Content-Encoding and Vary)
+// can span
+#define VALIDATORS 192
+
+// fewest octets a response needs to be worth compressing on the fly
+#define DEFLATABLE 1024
+
+// most octets of CGI headers a script can output before its content
+#define PREAMBLE 16384
+
+// fewest octets of output waiting in php-cgi's pipe worth splicing to client rather than copying
+#define SPLICEABLE 4096
+
+// most ranges of a file a request can ask for, and most octets of a file's ranges sent as multipart/byteranges
+#define RANGES 16
+#define EXCERPTS 1048576
+
+// FastCGI's version, types of records, role of a backend that responds to requests, flag that keeps a connection
+// open after a request, and most octets of a record's content
+// https://fastcgi-archives.github.io/FastCGI_Specification.html
+#define FCGI_VERSION_1 1
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+#define FCGI_RESPONDER 1
+#define FCGI_KEEP_CONN 1
+#define FCGI_CONTENT 65535
+
+// maximum number of events handled per call to epoll_wait
+#define EVENTS 256
+
+// tag in low bit of an epoll event's data, marking events on a connection's gateway rather than on its socket
+#define GATEWAY 1
+
+// most seconds to discard what a client still sends after its last response, before closing its connection
+#define LINGER 2
+
+// capacity of queue through which accepted sockets reach worker threads (a power of 2)
+#define QUEUE 4096
+
+#ifdef HAVE_LIBURING
+// io_uring's submission queue depth, and number and size of buffers in each ring of buffers for receiving
+#define ENTRIES 4096
+#define BUFFERS 1024
+#define BUFFER 4096
+
+// io_uring operations, kept in the low bits of each submission's user data
+#define ACCEPT 1
+#define RECV 2
+#define SEND 3
+#define READ 4
+#define WAKE 5
+#define CANCEL 6
+#define RELAY 7
+#define OPERATION 7
+#endif
+
 // header files
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
 #include <limits.h>
-#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/random.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 // types
 typedef char octet;
 
+// a run of octets in a connection's buffer, by offset and length rather than by copy
+typedef struct
+{
+    size_t offset;
+    size_t length;
+}
+view;
+
+// where a parser is within a request's headers
+typedef enum
+{
+    METHOD,   // request-line's method
+    TARGET,   // request-line's request-target
+    VERSION,  // request-line's HTTP-version
+    LINE_LF,  // LF ending request-line
+    FIELD,    // start of a header field (or of CRLF ending headers)
+    NAME,     // header field's name
+    VALUE,    // header field's value
+    FIELD_LF, // LF ending a header field
+    FINAL_LF  // LF ending headers
+}
+phase;
+
+// a resumable parser of a request's headers
+// http://www.w3.org/Protocols/rfc2616/rfc2616-sec5.html
+typedef struct
+{
+    // where parser is, offset of next octet to parse, of token being parsed, and of line being parsed
+    phase phase;
+    size_t position;
+    size_t start;
+    size_t line;
+
+    // request-line's parts, target's path and query (query.offset is 0 if there's no "?")
+    view method;
+    view target;
+    view path;
+    view query;
+    view version;
+
+    // header fields' names and values
+    view names[LimitRequestFields];
+    view values[LimitRequestFields];
+    int fields;
+}
+parser;
+
+// a FastCGI backend (a php-cgi process of an event loop's own), the socket on which it listens, and the loop's
+// persistent connection to it, if any
+typedef struct backend
+{
+    pid_t pid;
+    int lfd;
+    struct sockaddr_un address;
+    socklen_t addrlen;
+    int fd;
+    bool busy;
+}
+backend;
+
+// states of a connection
+typedef enum
+{
+    READING,    // reading request's headers
+    RESPONDING, // building response
+    WAITING,    // waiting for a PHP script's output
+    WRITING,    // writing response
+    LINGERING,  // done writing, discarding whatever client still sends until it closes its end
+    CLOSING     // done, waiting to be closed
+}
+state;
+
+// part of a connection's responses, either octets of its response buffer or a cached file's contents
+typedef struct
+{
+    // cached file whose contents this is, else NULL
+    struct entry* file;
+
+    // where part begins in response buffer (or in cached file's contents), and its length
+    size_t offset;
+    size_t length;
+}
+segment;
+
+// per-connection state
+typedef struct connection
+{
+    // file descriptor for client's socket
+    int cfd;
+
+    // where this connection is in its lifecycle
+    state state;
+
+    // buffer for request, how many octets it can hold, and how many it holds
+    octet* request;
+    size_t capacity;
+    size_t length;
+
+    // parser of request's headers
+    parser parser;
+
+    // FILE pointer for files
+    FILE* file;
+
+    // buffer for response-body
+    octet* body;
+
+    // buffer for responses' headers (and any bodies not cached), how many octets it can hold, and how many it holds
+    octet* response;
+    size_t reserved;
+    size_t size;
+
+    // responses, as parts to be written in order (all at once), how many parts there are, which is first unwritten,
+    // how much of it has been written, and how many octets remain to be written in all
+    segment segments[SEGMENTS];
+    int parts;
+    int first;
+    size_t sent;
+    size_t queued;
+
+    // where current response begins, in buffer and in parts, after those to pipelined requests batched before it
+    size_t start;
+    int begun;
+
+    // octets of file still to be sent after response's headers (or read into response, by io_uring),
+    // and from which offset
+    size_t pending;
+    off_t offset;
+
+    // gateway through which a PHP script's output arrives (a php-cgi's stdout, or a FastCGI backend's connection),
+    // -1 if none; php-cgi's process (and process group), if connection started one; FastCGI backend running script,
+    // if any; FastCGI request still to be sent to one, and its length; and whether script ran out of time
+    int gfd;
+    pid_t pid;
+    struct backend* backend;
+    octet* framed;
+    size_t framedlen;
+    bool expired;
+
+    // octets of script's output loaded into body, and how many body can hold
+    size_t loaded;
+    size_t allocated;
+
+    // FastCGI record being received: its header, how many octets of that have been received,
+    // then how many octets of its content and padding remain
+    octet record[8];
+    int recorded;
+    size_t remaining;
+    size_t padding;
+
+    // whether script's CGI headers have been turned into response's, whether its content follows them (in chunks)
+    // or is discarded (as for 304), and whether gateway has no more output until its next event
+    bool streaming;
+    bool chunked;
+    bool drained;
+
+    // octets of chunk of script's output still to be spliced to client straight from php-cgi's pipe,
+    // and whether chunk's closing CRLF is still owed
+    size_t spliced;
+    bool owing;
+
+#ifdef HAVE_ZLIB
+    // gzip stream compressing script's content, if any
+    z_stream* deflating;
+#endif
+
+    // next connection waiting for a FastCGI backend (or closed during same wakeup of its loop)
+    struct connection* behind;
+
+    // io_uring operations in flight, and whether a multishot recv is among them
+    unsigned int inflight;
+    bool armed;
+
+#ifdef HAVE_LIBURING
+    // responses' parts, as being sent by io_uring
+    struct iovec vectors[SEGMENTS];
+    struct msghdr message;
+#endif
+
+    // requests received on this connection, and whether to keep it open after current one
+    int requests;
+    bool persistent;
+
+    // when connection last saw activity
+    time_t active;
+
+    // worker serving this connection
+    struct worker* worker;
+
+    // neighbours in worker's list of open connections, least recently active first
+    struct connection* prev;
+    struct connection* next;
+}
+connection;
+
+// an event loop, run by the main thread or by one of the worker threads
+typedef struct worker
+{
+    // thread running this loop
+    pthread_t thread;
+
+    // file descriptor for this loop's epoll instance
+    int efd;
+
+    // file descriptor for eventfd through which accepted sockets are announced
+    int wfd;
+
+    // open connections, least recently active first, and most recently active
+    connection* connections;
+    connection* last;
+
+    // current time, as of loop's latest wakeup, and when idle connections were last closed
+    time_t now;
+    time_t swept;
+
+    // Date header for current time, rendered once a second, and its length
+    char date[64];
+    size_t datelen;
+
+    // FastCGI backends this loop runs PHP scripts on, if any, and connections waiting for one to be free, in order
+    backend* interpreters;
+    connection* waiting;
+
+    // php-cgi processes that have yet to exit (and be reaped), and how many
+    pid_t* exiting;
+    int exits;
+
+    // connections closed while handling this wakeup's events, freed once none of those can refer to them
+    connection* closed;
+
+#ifdef HAVE_LIBURING
+    // io_uring instance, its ring of buffers for receiving, and the memory behind those buffers
+    struct io_uring ring;
+    struct io_uring_buf_ring* buffers;
+    octet* pool;
+
+    // counter read from eventfd
+    uint64_t wakeups;
+#endif
+}
+worker;
+
+// file cached in memory, along with what's needed to respond with it
+typedef struct entry
+{
+    // file's path, relative to server's root
+    char* path;
+
+    // file's pre-rendered headers (those that don't vary from response to response) followed by its contents,
+    // and their length, and length of file's validators (and any Content-Encoding and Vary), with which block begins
+    octet* block;
+    size_t length;
+    size_t validators;
+
+    // file's contents, within block, and their length
+    octet* content;
+    size_t size;
+
+    // file's MIME type (or, for a precompressed sidecar, its original's), its encoding (NULL for identity),
+    // and when it was last modified
+    const char* type;
+    const char* encoding;
+    time_t modified;
+
+    // file's status when read, from which any variant compressed on the fly takes its validators,
+    // and whether compressing it on the fly proved not to be worth it
+    struct stat info;
+    bool incompressible;
+
+    // number of responses yet to send file's contents, and whether file has left cache (to be freed once unreferenced)
+    int references;
+    bool forgotten;
+
+    // next entry in same bucket
+    struct entry* chain;
+
+    // neighbours in cache's list of entries, least recently used first
+    struct entry* prev;
+    struct entry* next;
+}
+entry;
+
+// file within server's root, as indexed at startup and kept current as it changes
+typedef struct
+{
+    // file's path, relative to server's root, NULL if slot has never been used or vacant if file has since gone
+    char* path;
+
+    // file's size, and when it was last modified
+    off_t size;
+    time_t modified;
+
+    // file's MIME type, NULL if unknown
+    const char* type;
+
+    // whether server can read file
+    bool readable;
+}
+record;
+
+// range of a file's octets requested by a client, from first to last inclusive
+typedef struct
+{
+    size_t first;
+    size_t last;
+}
+range;
+
+// path found missing from server's root, cached so that further requests for it are answered without asking filesystem
+typedef struct
+{
+    // path, relative to server's root (NULL if slot is free), its hash, and when it's to be forgotten
+    char* path;
+    uint64_t hash;
+    time_t expires;
+}
+absence;
+
+// status with which server responds, along with pre-rendered parts of responses with it
+typedef struct
+{
+    // Status-Code and Reason-Phrase
+    unsigned short code;
+    const char* phrase;
+
+    // Status-Line, and its length
+    char* line;
+    size_t linelen;
+
+    // for errors, headers that don't vary from response to response followed by message-body, and their length
+    char* tail;
+    size_t taillen;
+}
+status;
+
+// counters kept by each worker process (or lone process), shared between processes
+typedef struct
+{
+    // connections accepted
+    atomic_ulong accepts;
+
+    // files found in cache, files not found there, and files evicted from it to make room
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong evictions;
+
+    // requests for missing files answered from cache
+    atomic_ulong absences;
+
+    // responses compressed on the fly, microseconds of CPU spent compressing them, and octets before and after
+    atomic_ulong compressions;
+    atomic_ulong compressing;
+    atomic_ulong uncompressed;
+    atomic_ulong compressed;
+}
+counters;
+
+// an extension's MIME type
+typedef struct
+{
+    const char* extension;
+    const char* type;
+}
+mapping;
+
+// slot in queue of accepted sockets
+typedef struct
+{
+    atomic_size_t sequence;
+    int cfd;
+}
+slot;
+
+// bounded lock-free multi-producer, multi-consumer queue of accepted sockets
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+typedef struct
+{
+    slot slots[QUEUE];
+    _Alignas(64) atomic_size_t enqueued;
+    _Alignas(64) atomic_size_t dequeued;
+}
+queue;
+
 // prototypes
-bool connected(void);
-bool error(unsigned short code);
+void abandon(connection* c);
+bool absent(const char* path, time_t now);
+bool absorb(connection* c, size_t octets);
+bool accepts(connection* c, view value, const char* coding);
+bool adopt(worker* w, int cfd);
+bool append(connection* c, const octet* octets, size_t length);
+bool attach(connection* c, struct entry* file, size_t offset, size_t length);
+bool batched(connection* c);
+bool bodied(connection* c);
+void bury(worker* w);
+void advance(connection* c, size_t octets);
+void announce(status* s);
+bool canonical(const char* path);
+bool chunk(connection* c, const octet* octets, size_t length);
+bool compressible(const char* type);
+bool commence(connection* c, backend* b);
+void conclude(connection* c, bool complete);
+entry* create(const char* path, const char* type, const char* encoding, const struct stat* info, size_t size);
+void catalog(const char* path, const struct stat* info);
+void connected(worker* w);
+bool contained(const char* path);
+bool contains(connection* c, view value, const char* token);
+bool delegate(connection* c, const char* path, const char* query);
+bool deliver(connection* c, entry* e);
+void detach(connection* c, bool complete);
+bool dequeue(int* cfd);
+void discard(entry* e);
+void disengage(worker* w, backend* b);
+status* describe(unsigned short code);
+void dispense(connection* c, const char* path, const char* type, const char* encoding);
+void dispatch(void);
+void empty(connection* c);
+octet* encode(connection* c, const char* path, const char* query, size_t* length);
+backend* engage(worker* w);
+bool enqueue(int cfd);
+char** environment(connection* c, const char* path, const char* query);
+bool error(connection* c, unsigned short code);
+bool excerpt(connection* c, entry* e, const char* validators, size_t length, const char* type, size_t size,
+    range* ranges, int count);
+void expire(worker* w);
+bool field(connection* c, const char* name, view* value);
+int flush(connection* c);
+uint64_t fold(const char* extension, uint32_t seed);
+bool fresh(connection* c, const char* validators, size_t length, time_t modified);
+void forget(entry* e);
+bool format(connection* c, const char* template, ...);
+int gather(connection* c, struct iovec* vectors);
+bool grow(connection* c, size_t octets);
+uint64_t hash(const char* path);
 void handler(int signal);
-ssize_t load(void);
+void invalidate(const char* path);
+void launch(void);
+void linger(connection* c);
+int listener(short port, bool listens);
 const char* lookup(const char* extension);
-ssize_t parse(void);
-void reset(void);
+entry* locate(const char* path, const char* encoding);
+void loop(worker* w);
+void mark(const char* path, unsigned long before, time_t now);
+void neglect(const char* directory, bool neglected);
+bool observed(const char* path, int fd);
+bool pair(octet** params, size_t* length, size_t* capacity, const char* name, size_t namelen, const char* value, size_t valuelen);
+ssize_t parse(connection* c);
+void reap(worker* w, pid_t pid);
+bool recall(connection* c, const char* path, const char* encoding);
+bool precompressed(connection* c, const char* path, const char* type);
+bool preface(connection* c, status* s);
+record* probe(const char* path);
+bool receive(connection* c, const octet* octets, size_t length);
+void recycle(connection* c);
+bool remember(connection* c, const char* path, const char* type, const char* encoding, const struct stat* info);
+void release(connection* c, int from);
+void report(void);
+void render(void);
+void recruit(worker* w);
+void relay(connection* c);
+bool reserve(connection* c, size_t octets);
+void refresh(const char* path);
+void store(entry* e, unsigned long before);
+void reset(connection* c);
+void respond(connection* c);
+ssize_t resume(connection* c);
+size_t scan_scalar(const octet* buffer, size_t from, size_t to, bool lines);
+char* search(const char* program);
+void serve(connection* c);
+bool siphon(connection* c);
+int span(connection* c, size_t size, const char* validators, size_t length, time_t modified, range* ranges);
+bool spawn(int i);
+void stamp(worker* w);
 void start(short port, const char* path);
 void stop(void);
+bool stream(connection* c);
+void summon(backend* b);
+void supervise(void);
+int survey(const char* path, const struct stat* info, int flag, struct FTW* ftw);
+bool tabulate(const char* path);
+int tag(char* buffer, size_t size, const struct stat* info, const char* encoding, bool vary);
+time_t timestamp(connection* c, view value);
+void touch(connection* c);
+bool translate(connection* c, size_t headers);
+void* watch(void* arg);
+bool widen(connection* c);
+void withdraw(const char* path, bool directory);
+void* work(void* arg);
+
+#if defined(__x86_64__) || defined(__i386__)
+size_t scan_avx2(const octet* buffer, size_t from, size_t to, bool lines);
+size_t scan_sse42(const octet* buffer, size_t from, size_t to, bool lines);
+#endif
+
+#ifdef HAVE_ZLIB
+bool affordable(void);
+bool compressing(connection* c, const char* type);
+bool condense(connection* c, const char* path, const char* type);
+octet* gzip(const octet* octets, size_t length, size_t* compressed);
+void seal(connection* c);
+bool squeeze(connection* c, const octet* octets, size_t length, bool finishing);
+entry* variant(entry* e);
+#endif
+
+#ifdef HAVE_LIBURING
+void prime(worker* w);
+void proceed(connection* c);
+void ring(worker* w);
+struct io_uring_sqe* submission(worker* w);
+void transmit(connection* c);
+#endif
 
 // server's root
 char* root = NULL;
 
-// file descriptor for sockets. Computer and Server file descriptor
-int cfd = -1, sfd = -1;
+// file descriptor for server's root, relative to which paths are resolved
+int rfd = -1;
+
+// file descriptor for server's socket
+int sfd = -1;
+
+// port on which server listens
+unsigned short listening = 0;
+
+// number of worker processes, 0 if this process serves clients itself
+int processes = 0;
 
-// buffer for request
-octet* request = NULL;
+// whether to pin each worker process to a CPU core
+bool pinned = false;
 
-// FILE pointer for files
-FILE* file = NULL;
+// worker processes' IDs (in master process only)
+pid_t* pids = NULL;
 
-// buffer for response-body
-octet* body = NULL;
+// this process's index among worker processes, -1 for master (or lone) process
+int self = -1;
+
+// counters kept by each worker process (or lone process), shared between processes
+counters* stats = NULL;
+
+// statuses with which server responds, each pre-rendered by render() at startup
+// http://www.w3.org/Protocols/rfc2616/rfc2616-sec6.html#sec6.1
+status statuses[] =
+{
+    {.code = 200, .phrase = "OK"},
+    {.code = 206, .phrase = "Partial Content"},
+    {.code = 302, .phrase = "Found"},
+    {.code = 304, .phrase = "Not Modified"},
+    {.code = 400, .phrase = "Bad Request"},
+    {.code = 403, .phrase = "Forbidden"},
+    {.code = 404, .phrase = "Not Found"},
+    {.code = 405, .phrase = "Method Not Allowed"},
+    {.code = 413, .phrase = "Request Entity Too Large"},
+    {.code = 414, .phrase = "Request-URI Too Long"},
+    {.code = 416, .phrase = "Requested Range Not Satisfiable"},
+    {.code = 418, .phrase = "I'm a teapot"},
+    {.code = 431, .phrase = "Request Header Fields Too Large"},
+    {.code = 500, .phrase = "Internal Server Error"},
+    {.code = 501, .phrase = "Not Implemented"},
+    {.code = 502, .phrase = "Bad Gateway"},
+    {.code = 504, .phrase = "Gateway Timeout"},
+    {.code = 505, .phrase = "HTTP Version Not Supported"}
+};
+
+// number of worker threads, 0 if main thread serves clients itself
+int threads = 0;
+
+// event loops, one per worker thread (or just one, for main thread)
+worker* workers = NULL;
+
+// accepted sockets on their way from main thread to worker threads
+queue accepted;
+
+// whether event loops run on io_uring rather than epoll
+bool uring = false;
+
+// most requests served per connection
+int keepalive = 100;
+
+// seconds a connection may sit idle before it's closed
+int timeout = 5;
+
+// files cached in memory, by path, and from least to most recently used
+entry* buckets[BUCKETS];
+entry* oldest = NULL;
+entry* newest = NULL;
+
+// octets cached, and most octets to cache
+size_t cached = 0;
+size_t budget = 64 * 1048576;
+
+// paths found missing, by hash
+absence absences[ABSENCES];
+
+// lock for caches (of files and of paths found missing), shared by worker threads
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// number of times cached files have been invalidated, so that a file that changes while read isn't cached
+// (nor a path that appears while found missing)
+atomic_ulong generation = 0;
+
+// whether server's root is indexed at startup, so that requests are resolved without asking filesystem
+bool indexed = false;
+
+// index of files within server's root, by path (with open addressing, over a power of 2 of slots), number of slots
+// used (including those since vacated) and of files indexed, and lock for index, shared by worker threads and watch()
+record* records = NULL;
+size_t slots = 0;
+size_t occupied = 0;
+size_t filed = 0;
+pthread_rwlock_t guard = PTHREAD_RWLOCK_INITIALIZER;
+
+// path of any slot in index whose file has gone, so that probes continue past it
+char vacant[] = "";
+
+// inotify instance watching server's root for changes, and each watched directory's path, by watch descriptor
+int nfd = -1;
+char** watched = NULL;
+int watches = 0;
+
+// directories within server's root (relative to it) that couldn't be watched, whose files therefore aren't cached,
+// and how many (guarded by cache's lock)
+char** unwatched = NULL;
+int unwatchables = 0;
+
+// boundary between parts of multipart/byteranges responses, chosen at random by render() at startup
+char boundary[17];
+
+// number of FastCGI backends (php-cgi processes) each event loop runs PHP scripts on, 0 if it runs each script
+// in a php-cgi process of its own
+int backends = 0;
+
+// php-cgi's path, as found on PATH at startup, so that FastCGI backends can be exec'd without searching it
+char* interpreter = NULL;
+
+// seconds a PHP script may run before its request is answered with 504
+int gateway = 30;
+
+// MIME types of extensions known without a mime.types file
+mapping builtins[] =
+{
+    {"css", "text/css"},
+    {"gif", "image/gif"},
+    {"htm", "text/html"},
+    {"html", "text/html"},
+    {"ico", "image/x-icon"},
+    {"jpeg", "image/jpeg"},
+    {"jpg", "image/jpeg"},
+    {"js", "text/javascript"},
+    {"json", "application/json"},
+    {"mp4", "video/mp4"},
+    {"pdf", "application/pdf"},
+    {"png", "image/png"},
+    {"svg", "image/svg+xml"},
+    {"txt", "text/plain"},
+    {"wasm", "application/wasm"},
+    {"webp", "image/webp"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"xml", "application/xml"}
+};
+
+// path of any mime.types file whose mappings add to (or override) those built in
+const char* mimetypes = NULL;
+
+// MIME types by extension, hashed perfectly (over a power of 2 of slots), so that an extension's hash picks
+// a group (of a power of 2 of groups), whose displacement, rehashing the extension, picks the extension's one slot
+mapping* mappings = NULL;
+uint32_t* displacements = NULL;
+size_t spread = 0;
+size_t groups = 0;
+
+// milliseconds of CPU per second each process may spend compressing responses on the fly (0 if it mustn't),
+// and microseconds it's spent so far during which second
+int allowance = 0;
+atomic_ulong spent = 0;
+atomic_long period = 0;
+
+// finds next octet in a request that matters to its parser, using the fastest instructions this CPU supports
+size_t (*scan)(const octet* buffer, size_t from, size_t to, bool lines) = scan_scalar;
 
 int main(int argc, char* argv[])
 {
@@ -68,29 +838,105 @@ int main(int argc, char* argv[])
     // default to a random port
     int port = 0;
 
-    // usage
-    const char* usage = "Usage: server [-p port] /path/to/root";
+    // usage (mentioning -u only if server was built with io_uring, which is experimental)
+    const char* usage = "Usage: server [-p port] [-t threads] [-w processes [-c]] "
+#ifdef HAVE_LIBURING
+        "[-u] "
+#endif
+        "[-k requests] [-i seconds] [-m megabytes] [-e mime.types] [-f backends] [-g seconds] [-x] [-z milliseconds] /path/to/root";
 
     // parse command-line arguments
     int opt;
-    while ((opt = getopt(argc, argv, "hp:")) != -1)
+    while ((opt = getopt(argc, argv, "ce:f:g:hi:k:m:p:t:uw:xz:")) != -1)
     {
         switch (opt)
         {
+            // -c
+            case 'c':
+                pinned = true;
+                break;
+
+            // -e mime.types
+            case 'e':
+                mimetypes = optarg;
+                break;
+
+            // -f backends
+            case 'f':
+                backends = atoi(optarg);
+                break;
+
+            // -g seconds
+            case 'g':
+                gateway = atoi(optarg);
+                break;
+
             // -h
             case 'h':
                 printf("%s\n", usage);
                 return 0;
 
+            // -i seconds
+            case 'i':
+                timeout = atoi(optarg);
+                break;
+
+            // -k requests
+            case 'k':
+                keepalive = atoi(optarg);
+                break;
+
+            // -m megabytes
+            case 'm':
+                budget = (size_t) atoi(optarg) * 1048576;
+                break;
+
             // -p port
             case 'p':
                 port = atoi(optarg);
                 break;
+
+            // -t threads
+            case 't':
+                threads = atoi(optarg);
+                break;
+
+            // -u
+            case 'u':
+#ifdef HAVE_LIBURING
+                uring = true;
+                break;
+#else
+                printf("server was built without io_uring (compile with -DHAVE_LIBURING -luring)\n");
+                return 2;
+#endif
+
+            // -w processes
+            case 'w':
+                processes = atoi(optarg);
+                break;
+
+            // -x
+            case 'x':
+                indexed = true;
+                break;
+
+            // -z milliseconds
+            case 'z':
+#ifdef HAVE_ZLIB
+                allowance = atoi(optarg);
+                break;
+#else
+                printf("server was built without zlib (compile with -DHAVE_ZLIB -lz)\n");
+                return 2;
+#endif
         }
     }
 
-    // ensure port is a non-negative short and path to server's root is specified
-    if (port < 0 || port > SHRT_MAX || argv[optind] == NULL || strlen(argv[optind]) == 0)
+    // ensure port is a non-negative short, threads, processes and backends are non-negative,
+    // connections carry at least one request and idle (or wait for scripts) for at least a second,
+    // and path to server's root is specified
+    if (port < 0 || port > SHRT_MAX || threads < 0 || processes < 0 || keepalive < 1 || timeout < 1 || gateway < 1 || allowance < 0 || backends < 0 || argv[optind] == NULL || strlen(argv[optind]) == 0)
     {
         // announce usage
         printf("%s\n", usage);
@@ -99,729 +945,5644 @@ int main(int argc, char* argv[])
         return 2;
     }
 
+    // find php-cgi for FastCGI backends now, since searching PATH isn't safe between fork and exec
+    if (backends > 0)
+    {
+        interpreter = search("php-cgi");
+        if (interpreter == NULL)
+        {
+            printf("php-cgi not found on PATH\n");
+            return 1;
+        }
+    }
+
     // start server
     start(port, argv[optind]); // starts the server configured to a specific port and assigns a root directory to it
 
     // listen for SIGINT (aka control-c)
     signal(SIGINT, handler);
-    
 
-    while (true)
+    // ignore SIGPIPE, since failed writes to clients are handled where they happen
+    signal(SIGPIPE, SIG_IGN);
+
+    // listen for SIGUSR1, on which connections accepted and cache's counters are reported
+    signal(SIGUSR1, handler);
+
+    // with worker processes, this (master) process only supervises them,
+    // and only worker processes return from here
+    if (processes > 0)
+    {
+        supervise();
+    }
+
+    // create event loops
+    launch();
+
+    // serve clients from this thread, or hand them to worker threads
+    if (threads == 0)
+    {
+        work(&workers[0]);
+    }
+    else
     {
-        // reset server's state
-        reset();
+        dispatch();
+    }
+}
 
-        // wait until client is connected
-        if (connected())
+/**
+ * Gives up on connection's script once it's run out of time: answers at once if script's yet to reach a backend,
+ * else cuts its output short (killing its php-cgi, or shutting down its backend's connection, so that the backend's
+ * restarted), leaving relay to answer with 504 once the output ends.
+ */
+void abandon(connection* c)
+{
+    c->expired = true;
+    if (c->gfd != -1)
+    {
+        if (c->backend != NULL)
         {
-            // parse client's HTTP request
-            ssize_t octets = parse();
-            if (octets == -1)
-            {
-                continue;
-            }
+            shutdown(c->gfd, SHUT_RDWR);
+        }
+        else
+        {
+            kill(-c->pid, SIGKILL);
+        }
+        errno = 0;
+        return;
+    }
+    conclude(c, false);
+#ifdef HAVE_LIBURING
+    if (uring)
+    {
+        proceed(c);
+        return;
+    }
+#endif
+    serve(c);
+}
 
-            // extract request's request-line // extracts the line GET /cat.html HTTP/1.1
-            // http://www.w3.org/Protocols/rfc2616/rfc2616-sec5.html
-            const char* haystack = request;
-            char* needle = strstr(haystack, "\r\n"); //\r\n is what separates the header and beginning of the needle
-            
-            if (needle == NULL)
-            {
-                error(400);
-                continue;
-            }
-            else if (needle - haystack + 2 > LimitRequestLine) // needle - haystack + 2 -> size of request line
-            {
-                error(414);
-                continue;
-            }   
-            char line[needle - haystack + 2 + 1]; 
-            strncpy(line, haystack, needle - haystack + 2);
-            line[needle - haystack + 2] = '\0'; //  finish the string with NULL
+/**
+ * Returns true if path (relative to server's root) was recently found missing and hasn't since appeared.
+ */
+bool absent(const char* path, time_t now)
+{
+    if (budget == 0)
+    {
+        return false;
+    }
+    uint64_t h = hash(path);
+    absence* a = &absences[h & (ABSENCES - 1)];
+    pthread_mutex_lock(&lock);
+    bool found = (a->path != NULL && a->hash == h && a->expires > now && strcmp(a->path, path) == 0);
+    pthread_mutex_unlock(&lock);
+    return found;
+}
 
-            // log request-line
-            printf("%s", line); 
+/**
+ * Takes in octets of script's output just read into body, after what's been loaded already, unwrapping
+ * FastCGI's records in place (moving FCGI_STDOUT's content down over headers and padding, and passing
+ * FCGI_STDERR's to server's stderr) if script's running on a backend.
+ * Returns true once backend has ended its response with FCGI_END_REQUEST.
+ */
+bool absorb(connection* c, size_t octets)
+{
+    // php-cgi's output is just that
+    if (c->backend == NULL)
+    {
+        c->loaded += octets;
+        return false;
+    }
 
-            // TODO: validate request-line
-            
-            // method must be GET
-            if (strncmp(line, "GET", 3) != 0) 
+    octet* in = c->body + c->loaded;
+    octet* end = in + octets;
+    while (in < end)
+    {
+        // record's header, which may arrive a few octets at a time
+        if (c->recorded < 8)
+        {
+            c->record[c->recorded++] = *in++;
+            if (c->recorded == 8)
             {
-                error(405);
-                continue;
-            }
-            
-            // request target must begin with "/"
-            char* line_pt = strchr(line, ' '); 
-            
-            char target_init[2] = "";
-            strncpy(target_init, line_pt, 2);
-
-            if (strncmp(target_init, " /",2) != 0)
-            {   
-                error(501);
-                continue;
-            }
-            
-            // request target must not contain "
-            if (strchr(line, '"') != NULL)
-            {   
-                error(400);
-                continue;
-            }
-            
-            // version must be "HTTP/1.1"
-            const char needle_1[9] = "HTTP/1.1\0";
-            
-            const char* line_ct = line;
-            
-            char* needle_1_pt = strcasestr(line_ct, needle_1);
-            
-            if(needle_1_pt == NULL)
-            {
-                error(505);
-                continue;
-            }            
-            
-            line_pt = strchr(line, '/'); 
-            
-            int ln_abs_path = needle_1_pt - line_pt; // lenght
-            
-            char abs_path[ln_abs_path];
-                        
-            memset(abs_path, 0, ln_abs_path); // initialize abs_path to 0
-            
-            strncpy(abs_path, line_pt, (ln_abs_path)); 
-            
-            abs_path[ln_abs_path - 1] = '\0'; 
-            
-            if (strchr(abs_path, '.') == NULL) 
-            {   
-                error(501);
-                continue;
+                c->remaining = (size_t) (unsigned char) c->record[4] << 8 | (unsigned char) c->record[5];
+                c->padding = (unsigned char) c->record[6];
             }
+        }
 
-            // TODO: extract query from request-target // this is the stuff after a question mark
-            
-            char* query = malloc(1*sizeof(octet));
-            *query = '\0';
-            char* query_bg = strchr(abs_path, '?'); // beginning query
-                                  
-            if (query_bg != NULL)
-            {
-                char* query_end = strchr(abs_path, '\0');
-                int query_ln = query_end - query_bg;
-                
-                if (query_ln > 1)
-                {
-                    query = realloc(query, query_ln);
-                    memset(query, 0, query_ln);
-                    strcpy(query, query_bg + 1);
-                    query[query_ln - 1] = '\0';
-                }
-                abs_path[query_bg - abs_path] = '\0'; // takes the query out of the absolute path to ensure it exists
-            }         
-                
-            // TODO: concatenate root and absolute-path
-            char path[strlen(root) + ln_abs_path - 1];
-            memset(path, 0, strlen(root) + ln_abs_path - 1);
-            strcpy (path, root);
-            strcat (path, abs_path);
-
-            // TODO: ensure path exists
-            
-            if (access(path, F_OK) == -1)
-            {
-                error(404);
-                continue;
+        // record's content
+        else if (c->remaining > 0)
+        {
+            size_t n = ((size_t) (end - in) < c->remaining) ? (size_t) (end - in) : c->remaining;
+            if (c->record[1] == FCGI_STDOUT)
+            {
+                memmove(c->body + c->loaded, in, n);
+                c->loaded += n;
             }
-            // TODO: ensure path is readable
-            if (access(path, R_OK) == -1)
+            else if (c->record[1] == FCGI_STDERR)
             {
-                error(403);
-                continue;
+                fwrite(in, 1, n, stderr);
             }
-            // TODO: extract path's extension
-            char* ext_pt_bg = strchr(path, '.');
-            char* ext_pt_end = strchr(path, '\0');
-            int ext_len = ext_pt_end - ext_pt_bg;
-
+            in += n;
+            c->remaining -= n;
+        }
 
-            
-            char extension[ext_len];
-            memset(extension, 0, ext_len);
-            strcpy(extension, ext_pt_bg + 1); // strcpy already copies the terminating null 
+        // record's padding
+        else
+        {
+            size_t n = ((size_t) (end - in) < c->padding) ? (size_t) (end - in) : c->padding;
+            in += n;
+            c->padding -= n;
+        }
 
-            // dynamic content
-            if (strcasecmp("php", extension) == 0)
+        // move on to next record
+        if (c->recorded == 8 && c->remaining == 0 && c->padding == 0)
+        {
+            c->recorded = 0;
+            if (c->record[1] == FCGI_END_REQUEST)
             {
-                // open pipe to PHP interpreter
-                char* format = "QUERY_STRING=\"%s\" REDIRECT_STATUS=200 SCRIPT_FILENAME=\"%s\" php-cgi";
-                char command[strlen(format) + (strlen(path) - 2) + (strlen(query) - 2) + 1];
-                sprintf(command, format, query, path);
-                
-                // free query, doesn't seem to be needed anymore
-                free (query); 
-
-                file = popen(command, "r"); // popen opens a pipe to a process php-cgi and returns a file pointer (file)
-                if (file == NULL)
-                {
-                    error(500);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Returns true if this process has yet to spend its allowance of CPU on compression during this second.
+ */
+bool affordable(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    long second = atomic_load(&period);
+    if (second != now.tv_sec && atomic_compare_exchange_strong(&period, &second, now.tv_sec))
+    {
+        atomic_store(&spent, 0);
+    }
+    return atomic_load(&spent) < (unsigned long) allowance * 1000;
+}
+#endif
+
+/**
+ * Returns true if a request's Accept-Encoding (whose value is given) accepts coding, by name or else by "*",
+ * with a nonzero qvalue.
+ * http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.3
+ */
+bool accepts(connection* c, view value, const char* coding)
+{
+    // whether coding, and "*", are accepted (1), refused (0) or unmentioned (-1)
+    int named = -1, starred = -1;
+    size_t length = strlen(coding);
+    const octet* item = c->request + value.offset;
+    const octet* end = item + value.length;
+    while (item < end)
+    {
+        // find item's end, and end of its coding's name
+        const octet* comma = memchr(item, ',', end - item);
+        const octet* stop = (comma != NULL) ? comma : end;
+        const octet* semicolon = memchr(item, ';', stop - item);
+        const octet* last = (semicolon != NULL) ? semicolon : stop;
+        while (item < last && (*item == ' ' || *item == '\t'))
+        {
+            item++;
+        }
+        while (last > item && (last[-1] == ' ' || last[-1] == '\t'))
+        {
+            last--;
+        }
+
+        // qvalue is nonzero unless it's all zeroes
+        int accepted = 1;
+        if (semicolon != NULL)
+        {
+            const octet* q = semicolon + 1;
+            while (q < stop && (*q == ' ' || *q == '\t'))
+            {
+                q++;
+            }
+            if (stop - q >= 2 && strncasecmp(q, "q=", 2) == 0)
+            {
+                accepted = 0;
+                for (q += 2; q < stop && *q != ' ' && *q != '\t' && *q != ';'; q++)
+                {
+                    if (*q >= '1' && *q <= '9')
+                    {
+                        accepted = 1;
+                    }
+                }
+            }
+        }
+        if (last - item == (ptrdiff_t) length && strncasecmp(item, coding, length) == 0)
+        {
+            named = accepted;
+        }
+        else if (last - item == 1 && *item == '*')
+        {
+            starred = accepted;
+        }
+        item = stop + 1;
+    }
+    return (named != -1) ? named == 1 : starred == 1;
+}
+
+/**
+ * Registers an accepted socket with a worker's event loop.
+ */
+bool adopt(worker* w, int cfd)
+{
+    // allocate connection's state
+    connection* c = calloc(1, sizeof(connection));
+    if (c == NULL)
+    {
+        close(cfd);
+        return false;
+    }
+    c->cfd = cfd;
+    c->gfd = -1;
+    c->state = READING;
+    c->worker = w;
+
+    // remember connection, as most recently active
+    c->active = w->now;
+    c->prev = w->last;
+    if (w->last != NULL)
+    {
+        w->last->next = c;
+    }
+    else
+    {
+        w->connections = c;
+    }
+    w->last = c;
+
+#ifdef HAVE_LIBURING
+    // with io_uring, start receiving into worker's ring of buffers
+    if (uring)
+    {
+        proceed(c);
+        return true;
+    }
+#endif
+
+    // watch client's socket, edge-triggered
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = c;
+    if (epoll_ctl(w->efd, EPOLL_CTL_ADD, cfd, &event) == -1)
+    {
+        errno = 0;
+        reset(c);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Notes that octets of connection's responses have been written, moving past parts written in full.
+ */
+void advance(connection* c, size_t octets)
+{
+    c->queued -= octets;
+    while (octets > 0 && c->first < c->parts)
+    {
+        size_t rest = c->segments[c->first].length - c->sent;
+        if (octets < rest)
+        {
+            c->sent += octets;
+            return;
+        }
+        octets -= rest;
+        c->sent = 0;
+        c->first++;
+    }
+}
+
+/**
+ * Announces Status-Line of a successful response.
+ */
+void announce(status* s)
+{
+    printf("\033[32m");
+    printf("HTTP/1.1 %i %s", s->code, s->phrase);
+    printf("\033[39m\n");
+}
+
+/**
+ * Appends octets to connection's response.
+ */
+bool append(connection* c, const octet* octets, size_t length)
+{
+    if (!reserve(c, length))
+    {
+        return false;
+    }
+    memcpy(c->response + c->size, octets, length);
+    if (!attach(c, NULL, c->size, length))
+    {
+        return false;
+    }
+    c->size += length;
+    return true;
+}
+
+/**
+ * Appends a part to connection's responses, merging it into the last part if they're adjacent in response buffer.
+ * Cache's lock must be held if part is a cached file's contents.
+ */
+bool attach(connection* c, entry* file, size_t offset, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+    segment* last = (c->parts > c->first) ? &c->segments[c->parts - 1] : NULL;
+    if (file == NULL && last != NULL && last->file == NULL && last->offset + last->length == offset)
+    {
+        last->length += length;
+    }
+    else
+    {
+        if (c->parts == SEGMENTS)
+        {
+            return false;
+        }
+        c->segments[c->parts++] = (segment) {.file = file, .offset = offset, .length = length};
+        if (file != NULL)
+        {
+            file->references++;
+        }
+    }
+    c->queued += length;
+    return true;
+}
+
+/**
+ * Reports whether enough responses await writing that no more should be batched behind them.
+ */
+bool batched(connection* c)
+{
+    return c->queued >= BATCH || c->parts > SEGMENTS - 4;
+}
+
+/**
+ * Reports whether request announces a message-body (with a Content-Length other than 0, or any Transfer-Encoding),
+ * which server never reads.
+ */
+bool bodied(connection* c)
+{
+    view value;
+    if (field(c, "Transfer-Encoding", &value))
+    {
+        return true;
+    }
+    if (field(c, "Content-Length", &value))
+    {
+        for (size_t i = 0; i < value.length; i++)
+        {
+            if (c->request[value.offset + i] != '0')
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Frees connections worker closed while handling its latest events, now that none of those can refer to them.
+ */
+void bury(worker* w)
+{
+    while (w->closed != NULL)
+    {
+        connection* c = w->closed;
+        w->closed = c->behind;
+        free(c);
+    }
+}
+
+/**
+ * Returns true if path (relative to server's root) is the one by which inotify would name its file,
+ * so that a cached file (or path found missing) can be invalidated by name.
+ */
+bool canonical(const char* path)
+{
+    return path[0] != '.' && strstr(path, "/.") == NULL && strstr(path, "//") == NULL;
+}
+
+/**
+ * Appends octets of script's content to connection's response as a chunk, unless response has no message-body.
+ */
+bool chunk(connection* c, const octet* octets, size_t length)
+{
+    if (!c->chunked || length == 0)
+    {
+        return true;
+    }
+    return format(c, "%zx\r\n", length) && append(c, octets, length) && append(c, "\r\n", 2);
+}
+
+/**
+ * Returns true if files of MIME type are worth compressing (being text rather than already compressed media),
+ * ignoring any parameters (e.g., "; charset=UTF-8") that follow type.
+ */
+bool compressible(const char* type)
+{
+    static const char* types[] = {"application/javascript", "application/json", "application/xml", "image/svg+xml"};
+    size_t length = strcspn(type, "; \t");
+    if (length > 5 && strncasecmp(type, "text/", 5) == 0)
+    {
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (length == strlen(types[i]) && strncasecmp(type, types[i], length) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Returns true if response of MIME type should be compressed on the fly for connection's client,
+ * it being worth compressing and client accepting it gzipped.
+ */
+bool compressing(connection* c, const char* type)
+{
+    view value;
+    return allowance > 0 && type != NULL && compressible(type) && field(c, "Accept-Encoding", &value) && accepts(c, value, "gzip");
+}
+
+/**
+ * Responds with a variant of file at path (relative to server's root) of MIME type, compressed on the fly,
+ * if client accepts one: from cache if it's been compressed already, else by compressing file's contents
+ * as cached (once, for every later response to share), within CPU budget. Returns true if so.
+ */
+bool condense(connection* c, const char* path, const char* type)
+{
+    if (!compressing(c, type))
+    {
+        return false;
+    }
+    if (recall(c, path, "gzip"))
+    {
+        return true;
+    }
+
+    // compress only files already cached, worth compressing, and only while budget allows
+    if (!affordable())
+    {
+        return false;
+    }
+    pthread_mutex_lock(&lock);
+    entry* e = locate(path, NULL);
+    if (e == NULL || e->incompressible || e->size < DEFLATABLE)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    unsigned long before = atomic_load(&generation);
+    e->references++;
+    pthread_mutex_unlock(&lock);
+
+    // compress file without holding cache's lock, referring to its contents so that they can't be freed meanwhile
+    entry* z = variant(e);
+
+    pthread_mutex_lock(&lock);
+    e->references--;
+    if (z == NULL)
+    {
+        e->incompressible = true;
+    }
+    if (e->references == 0 && e->forgotten)
+    {
+        discard(e);
+    }
+    if (z == NULL)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    // respond with variant, caching it alongside file unless file's changed meanwhile
+    bool delivered = deliver(c, z);
+    store(z, before);
+    pthread_mutex_unlock(&lock);
+    if (!delivered)
+    {
+        error(c, 500);
+    }
+    return true;
+}
+#endif
+
+/**
+ * Allocates an entry for file at path (relative to server's root) of MIME type, to be cached with encoding
+ * (NULL for identity), with room for its size octets of contents after its pre-rendered headers
+ * (validators first). Returns NULL if it can't.
+ */
+entry* create(const char* path, const char* type, const char* encoding, const struct stat* info, size_t size)
+{
+    char validators[VALIDATORS];
+    int v = tag(validators, sizeof(validators), info, encoding, compressible(type));
+    const char* template = "%sAccept-Ranges: bytes\r\nContent-Length: %zu\r\nContent-Type: %s\r\n\r\n";
+    int headers = snprintf(NULL, 0, template, validators, size, type);
+    entry* e = calloc(1, sizeof(entry));
+    if (e == NULL)
+    {
+        return NULL;
+    }
+    e->path = strdup(path);
+    e->block = malloc(headers + size + 1);
+    if (e->path == NULL || e->block == NULL)
+    {
+        discard(e);
+        return NULL;
+    }
+    sprintf((char*) e->block, template, validators, size, type);
+    e->content = e->block + headers;
+    e->length = headers + size;
+    e->validators = v;
+    e->size = size;
+    e->type = type;
+    e->encoding = encoding;
+    e->modified = info->st_mtime;
+    e->info = *info;
+    return e;
+}
+
+/**
+ * Adds file at path (relative to server's root) to index, or brings its record up to date if already there.
+ */
+void catalog(const char* path, const struct stat* info)
+{
+    // look up file's MIME type, and whether server can read it, before taking index's lock
+    const char* extension = strrchr(path, '.');
+    const char* type = (extension == NULL) ? NULL : lookup(extension + 1);
+    bool readable = (faccessat(rfd, path, R_OK, 0) == 0);
+    errno = 0;
+
+    pthread_rwlock_wrlock(&guard);
+    record* r = probe(path);
+    if (r == NULL)
+    {
+        // once index is half used, rehash its files into enough slots that they fill no more than a quarter of them,
+        // dropping vacated slots along the way
+        if (2 * (occupied + 1) > slots)
+        {
+            size_t size = (slots == 0) ? 1024 : slots;
+            while (4 * (filed + 1) > size)
+            {
+                size *= 2;
+            }
+            record* rehashed = calloc(size, sizeof(record));
+            if (rehashed == NULL)
+            {
+                pthread_rwlock_unlock(&guard);
+                return;
+            }
+            for (size_t i = 0; i < slots; i++)
+            {
+                if (records[i].path != NULL && records[i].path != vacant)
+                {
+                    size_t j = hash(records[i].path) & (size - 1);
+                    while (rehashed[j].path != NULL)
+                    {
+                        j = (j + 1) & (size - 1);
+                    }
+                    rehashed[j] = records[i];
+                }
+            }
+            free(records);
+            records = rehashed;
+            slots = size;
+            occupied = filed;
+        }
+
+        // take first slot that's unused or vacated
+        size_t i = hash(path) & (slots - 1);
+        while (records[i].path != NULL && records[i].path != vacant)
+        {
+            i = (i + 1) & (slots - 1);
+        }
+        char* copy = strdup(path);
+        if (copy == NULL)
+        {
+            pthread_rwlock_unlock(&guard);
+            return;
+        }
+        if (records[i].path == NULL)
+        {
+            occupied++;
+        }
+        filed++;
+        r = &records[i];
+        r->path = copy;
+    }
+    r->size = info->st_size;
+    r->modified = info->st_mtime;
+    r->type = type;
+    r->readable = readable;
+    pthread_rwlock_unlock(&guard);
+}
+
+/**
+ * Accepts connections from clients until none are pending, registering each with worker's epoll.
+ */
+void connected(worker* w)
+{
+    while (true)
+    {
+        // sockaddr is a structure that contains the the address family (http) and the socket address.
+        struct sockaddr_in cli_addr; // declare ONE struct socket address (contains family and IP)
+        memset(&cli_addr, 0, sizeof(cli_addr)); // fills the first sizeof(cli_addr) bytes with 0 (zeroes) to &cli_addr. IOW it initializes it to 0.
+        socklen_t cli_len = sizeof(cli_addr); // socklen_t is an unsigned 32 bites int. cli_len is the size of the client address
+
+        int cfd = accept4(sfd, (struct sockaddr*) &cli_addr, &cli_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd == -1)
+        {
+            // EAGAIN means no more connections are pending
+            errno = 0;
+            return;
+        }
+        atomic_fetch_add_explicit(&stats[self + 1].accepts, 1, memory_order_relaxed);
+        adopt(w, cfd);
+    }
+}
+
+/**
+ * Sends connection's FastCGI request to backend over its persistent connection (reconnecting, and restarting
+ * backend, once if that's broken), then watches that connection for script's output. The request's sent whole
+ * rather than a little at a time, since it's small and backend, being free, is waiting for it.
+ * Returns false if backend can't be reached.
+ */
+bool commence(connection* c, backend* b)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (b->fd == -1)
+        {
+            b->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (b->fd != -1 && connect(b->fd, (struct sockaddr*) &b->address, b->addrlen) == -1)
+            {
+                close(b->fd);
+                b->fd = -1;
+            }
+        }
+
+        // send request
+        size_t sent = 0;
+        while (b->fd != -1 && sent < c->framedlen)
+        {
+            ssize_t n = send(b->fd, c->framed + sent, c->framedlen - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+
+        // watch for script's output (with io_uring, proceed reads it), edge-triggered
+        bool watched = uring;
+        if (sent == c->framedlen && !watched)
+        {
+            struct epoll_event event;
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            event.data.u64 = (uintptr_t) c | GATEWAY;
+            watched = epoll_ctl(c->worker->efd, EPOLL_CTL_ADD, b->fd, &event) == 0;
+        }
+        if (watched)
+        {
+            free(c->framed);
+            c->framed = NULL;
+            c->backend = b;
+            c->gfd = b->fd;
+            c->drained = false;
+            b->busy = true;
+            return true;
+        }
+
+        // php-cgi drops a connection only when it's dying, so restart it
+        if (b->fd != -1)
+        {
+            close(b->fd);
+            b->fd = -1;
+        }
+        summon(b);
+    }
+    errno = 0;
+    return false;
+}
+
+/**
+ * Lets go of connection's gateway once script's output has ended (prematurely, unless complete), then ends
+ * response: with its last chunk, if script's headers were sent, else with 504 if script ran out of time, or 502.
+ * A response cut short is followed by closing connection, so that client can tell.
+ */
+void conclude(connection* c, bool complete)
+{
+    if (complete && !stream(c))
+    {
+        complete = false;
+    }
+    detach(c, complete);
+    touch(c);
+    c->state = WRITING;
+    if (!c->streaming)
+    {
+        error(c, c->expired ? 504 : 502);
+        return;
+    }
+    bool ended = complete && !c->expired;
+#ifdef HAVE_ZLIB
+    if (ended && c->deflating != NULL)
+    {
+        ended = squeeze(c, NULL, 0, true);
+    }
+    seal(c);
+#endif
+    if (ended && c->chunked)
+    {
+        ended = append(c, "0\r\n\r\n", 5);
+    }
+    if (!ended)
+    {
+        c->persistent = false;
+    }
+}
+
+/**
+ * Returns true if path (relative to server's root) has no ".." segment, and so can't resolve outside root.
+ */
+bool contained(const char* path)
+{
+    for (const char* segment = path; segment != NULL; segment = strchr(segment, '/'))
+    {
+        segment += (*segment == '/');
+        if (segment[0] == '.' && segment[1] == '.' && (segment[2] == '/' || segment[2] == '\0'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reports whether a comma-separated header value contains token, case-insensitively.
+ */
+bool contains(connection* c, view value, const char* token)
+{
+    size_t length = strlen(token);
+    const octet* item = c->request + value.offset;
+    const octet* end = item + value.length;
+    while (item < end)
+    {
+        // find item's end
+        const octet* comma = memchr(item, ',', end - item);
+        const octet* stop = (comma != NULL) ? comma : end;
+
+        // trim whitespace around item
+        const octet* last = stop;
+        while (item < last && (*item == ' ' || *item == '\t'))
+        {
+            item++;
+        }
+        while (last > item && (last[-1] == ' ' || last[-1] == '\t'))
+        {
+            last--;
+        }
+        if (last - item == (ptrdiff_t) length && strncasecmp(item, token, length) == 0)
+        {
+            return true;
+        }
+        item = stop + 1;
+    }
+    return false;
+}
+
+
+/**
+ * Starts PHP script at path (relative to server's root) with query on one of worker's FastCGI backends, if it has
+ * any (once one's free), else in a php-cgi of its own, whose output arrives through a pipe; connection then waits
+ * for script's output. Returns false if script can't be started (or, without backends, php-cgi can't be run).
+ */
+bool delegate(connection* c, const char* path, const char* query)
+{
+    worker* w = c->worker;
+    c->expired = false;
+    if (backends > 0)
+    {
+        c->framed = encode(c, path, query, &c->framedlen);
+        if (c->framed == NULL)
+        {
+            return false;
+        }
+
+        // wait, last in line, for a backend if none is free
+        backend* b = engage(w);
+        if (b == NULL)
+        {
+            connection** tail = &w->waiting;
+            while (*tail != NULL)
+            {
+                tail = &(*tail)->behind;
+            }
+            *tail = c;
+        }
+        else if (!commence(c, b))
+        {
+            free(c->framed);
+            c->framed = NULL;
+            return false;
+        }
+        c->state = WAITING;
+        return true;
+    }
+
+    // run php-cgi directly, with request as its environment, rather than by way of a shell, so that nothing
+    // in request is ever taken for a command
+    char** envp = environment(c, path, query);
+    if (envp == NULL)
+    {
+        return false;
+    }
+
+    // open pipe from php-cgi, which only server's end of survives an exec
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        free(envp);
+        errno = 0;
+        return false;
+    }
+
+    // spawn php-cgi (by way of vfork, which copies none of server's page tables, however much memory server maps)
+    // with its stdout on pipe, leading a process group of its own, so that it's killed along with any process
+    // it starts, with signals that worker threads block (or server ignores) restored
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attributes);
+    sigset_t none;
+    sigset_t ignored;
+    sigemptyset(&none);
+    sigemptyset(&ignored);
+    sigaddset(&ignored, SIGPIPE);
+    char* argv[] = {"php-cgi", NULL};
+    pid_t pid = -1;
+    if (posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO) != 0 ||
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF) != 0 ||
+        posix_spawnattr_setpgroup(&attributes, 0) != 0 || posix_spawnattr_setsigmask(&attributes, &none) != 0 ||
+        posix_spawnattr_setsigdefault(&attributes, &ignored) != 0 || posix_spawnp(&pid, "php-cgi", &actions, &attributes, argv, envp) != 0)
+    {
+        pid = -1;
+    }
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    free(envp);
+    close(fds[1]);
+    if (pid == -1)
+    {
+        close(fds[0]);
+        errno = 0;
+        return false;
+    }
+    c->gfd = fds[0];
+    c->pid = pid;
+    c->drained = false;
+
+    // watch for script's output (with io_uring, proceed reads it), edge-triggered
+    if (!uring)
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = (uintptr_t) c | GATEWAY;
+        if (fcntl(c->gfd, F_SETFL, O_NONBLOCK) == -1 || epoll_ctl(w->efd, EPOLL_CTL_ADD, c->gfd, &event) == -1)
+        {
+            detach(c, false);
+            errno = 0;
+            return false;
+        }
+    }
+    errno = 0;
+    c->state = WAITING;
+    return true;
+}
+
+/**
+ * Appends response with cached file, headers and all (or with just its validators, or ranges of its contents,
+ * as request asks), to connection's responses, referring to file's pre-rendered headers and contents
+ * rather than copying them where it can. Cache's lock must be held.
+ */
+bool deliver(connection* c, entry* e)
+{
+    // respond with just file's validators if client's copy is current
+    if (fresh(c, e->block, e->validators, e->modified))
+    {
+        if (!preface(c, describe(304)) || !attach(c, e, 0, e->validators) || !append(c, "\r\n", 2))
+        {
+            return false;
+        }
+        announce(describe(304));
+        return true;
+    }
+
+    // respond with just ranges of file that client requested, if any
+    range ranges[RANGES];
+    int count = span(c, e->size, (const char*) e->block, e->validators, e->modified, ranges);
+    if (count != 0)
+    {
+        return excerpt(c, e, (const char*) e->block, e->validators, e->type, e->size, ranges, count);
+    }
+
+    if (!preface(c, describe(200)) || !attach(c, e, 0, e->length))
+    {
+        return false;
+    }
+    announce(describe(200));
+    return true;
+}
+
+/**
+ * Lets go of connection's gateway: stops waiting for a backend, or returns its backend to worker's pool (restarting
+ * it first, unless complete, since script may still be running), or closes its php-cgi's output (killing php-cgi,
+ * unless complete) and reaps php-cgi.
+ */
+void detach(connection* c, bool complete)
+{
+    worker* w = c->worker;
+
+    // stop waiting for a backend
+    if (c->framed != NULL)
+    {
+        connection** link = &w->waiting;
+        while (*link != NULL && *link != c)
+        {
+            link = &(*link)->behind;
+        }
+        if (*link == c)
+        {
+            *link = c->behind;
+        }
+        c->behind = NULL;
+        free(c->framed);
+        c->framed = NULL;
+    }
+
+    // return backend to pool, ready for another request
+    else if (c->backend != NULL)
+    {
+        backend* b = c->backend;
+        c->backend = NULL;
+        c->gfd = -1;
+        c->recorded = 0;
+        c->remaining = c->padding = 0;
+        if (!uring)
+        {
+            epoll_ctl(w->efd, EPOLL_CTL_DEL, b->fd, NULL);
+        }
+        if (!complete)
+        {
+            close(b->fd);
+            b->fd = -1;
+            summon(b);
+        }
+        errno = 0;
+        disengage(w, b);
+    }
+
+    // close php-cgi's output, removing it from epoll first (lest another php-cgi being forked share it)
+    else if (c->pid > 0)
+    {
+        if (!uring)
+        {
+            epoll_ctl(w->efd, EPOLL_CTL_DEL, c->gfd, NULL);
+        }
+        close(c->gfd);
+        c->gfd = -1;
+        c->spliced = 0;
+        if (!complete)
+        {
+            kill(-c->pid, SIGKILL);
+        }
+        reap(w, c->pid);
+        c->pid = 0;
+        errno = 0;
+    }
+}
+
+/**
+ * Takes an accepted socket off the queue, if any. Safe to call from any thread.
+ */
+bool dequeue(int* cfd)
+{
+    size_t position = atomic_load_explicit(&accepted.dequeued, memory_order_relaxed);
+    while (true)
+    {
+        slot* s = &accepted.slots[position & (QUEUE - 1)];
+        size_t sequence = atomic_load_explicit(&s->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+
+        // slot has been filled, so try to claim it
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&accepted.dequeued, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                *cfd = s->cfd;
+                atomic_store_explicit(&s->sequence, position + QUEUE, memory_order_release);
+                return true;
+            }
+        }
+
+        // queue is empty
+        else if (difference < 0)
+        {
+            return false;
+        }
+
+        // another consumer got here first
+        else
+        {
+            position = atomic_load_explicit(&accepted.dequeued, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Returns status with given Status-Code, else NULL.
+ */
+status* describe(unsigned short code)
+{
+    for (size_t i = 0; i < sizeof(statuses) / sizeof(status); i++)
+    {
+        if (statuses[i].code == code)
+        {
+            return &statuses[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Responds with static file at path (relative to server's root) of MIME type (or with a precompressed sidecar
+ * of a file of that type, if encoding isn't NULL), from cache if small enough, else from filesystem.
+ */
+void dispense(connection* c, const char* path, const char* type, const char* encoding)
+{
+    // open file
+    int fd = openat(rfd, path, O_RDONLY | O_CLOEXEC); // here is where the magic happens. Opens the file in the server.
+    if (fd != -1)
+    {
+        c->file = fdopen(fd, "r");
+        if (c->file == NULL)
+        {
+            close(fd);
+        }
+    }
+    if (c->file == NULL)
+    {
+        errno = 0;
+        error(c, 500);
+        return;
+    }
+
+    // send file once headers are written (or, with io_uring, read it into response once they're queued)
+    struct stat info;
+    if (fstat(fileno(c->file), &info) == -1)
+    {
+        errno = 0;
+        error(c, 500);
+        return;
+    }
+
+    // only regular files are served (a directory, say, merely has a name that looks like a file's)
+    if (!S_ISREG(info.st_mode))
+    {
+        error(c, 404);
+        return;
+    }
+    size_t length = info.st_size;
+
+    // cache file and respond from memory if it's small enough
+    if (remember(c, path, type, encoding, &info))
+    {
+        return;
+    }
+
+    // else respond to client with just file's validators if client's copy is current
+    char validators[VALIDATORS];
+    int v = tag(validators, sizeof(validators), &info, encoding, compressible(type));
+    if (fresh(c, validators, v, info.st_mtime))
+    {
+        if (!preface(c, describe(304)))
+        {
+            return;
+        }
+        if (!format(c, "%s\r\n", validators))
+        {
+            return;
+        }
+        announce(describe(304));
+        return;
+    }
+
+    // else with just ranges of file that client requested, if any
+    range ranges[RANGES];
+    int count = span(c, length, validators, v, info.st_mtime, ranges);
+    if (count != 0)
+    {
+        if (!excerpt(c, NULL, validators, v, type, length, ranges, count))
+        {
+            error(c, 500);
+        }
+        return;
+    }
+
+    // else with headers, then file
+    if (!preface(c, describe(200)))
+    {
+        return;
+    }
+    if (!format(c, "%sAccept-Ranges: bytes\r\nContent-Length: %zu\r\n", validators, length))
+    {
+        return;
+    }
+    if (!format(c, "Content-Type: %s\r\n\r\n", type))
+    {
+        return;
+    }
+    c->pending = length;
+    announce(describe(200));
+}
+
+/**
+ * Deallocates entry that's no longer cached.
+ */
+void discard(entry* e)
+{
+    free(e->block);
+    free(e->path);
+    free(e);
+}
+
+/**
+ * Returns backend to worker's pool, then hands it to the first connection waiting for one, if any
+ * (answering with 502, and moving on to the next, any to which it can't be handed).
+ */
+void disengage(worker* w, backend* b)
+{
+    b->busy = false;
+    while (!b->busy && w->waiting != NULL)
+    {
+        connection* c = w->waiting;
+        w->waiting = c->behind;
+        c->behind = NULL;
+        if (!commence(c, b))
+        {
+            conclude(c, false);
+        }
+#ifdef HAVE_LIBURING
+        if (uring)
+        {
+            proceed(c);
+            continue;
+        }
+#endif
+        serve(c);
+    }
+}
+
+/**
+ * Accepts connections on main thread forever, handing each to a worker thread in turn.
+ */
+void dispatch(void)
+{
+    struct pollfd pfd = {.fd = sfd, .events = POLLIN};
+    int next = 0;
+    while (true)
+    {
+        // wait for a connection
+        if (poll(&pfd, 1, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                errno = 0;
+                continue;
+            }
+            stop();
+        }
+
+        // accept connections until none are pending
+        while (true)
+        {
+            int cfd = accept4(sfd, NULL, NULL, uring ? SOCK_CLOEXEC : SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (cfd == -1)
+            {
+                errno = 0;
+                break;
+            }
+            atomic_fetch_add_explicit(&stats[self + 1].accepts, 1, memory_order_relaxed);
+
+            // if queue is full, wait for workers to drain it
+            while (!enqueue(cfd))
+            {
+                sched_yield();
+            }
+
+            // wake next worker, whichever worker dequeues the socket will serve it
+            uint64_t one = 1;
+            if (write(workers[next].wfd, &one, sizeof(one)) == -1)
+            {
+                errno = 0;
+            }
+            next = (next + 1) % threads;
+        }
+    }
+}
+
+/**
+ * Empties connection's responses once they've been written, keeping their buffer.
+ */
+void empty(connection* c)
+{
+    release(c, 0);
+    c->size = c->start = 0;
+    c->first = c->begun = 0;
+    c->sent = c->queued = 0;
+}
+
+/**
+ * Frames a FastCGI request for PHP script at path (relative to server's root) with query, passing connection's
+ * request as CGI's meta-variables. Returns request, and its length by way of length, else NULL.
+ */
+octet* encode(connection* c, const char* path, const char* query, size_t* length)
+{
+    char** envp = environment(c, path, query);
+    if (envp == NULL)
+    {
+        return NULL;
+    }
+
+    // encode variables as name-value pairs
+    octet* params = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    bool encoded = true;
+    for (char** variable = envp; *variable != NULL && encoded; variable++)
+    {
+        const char* equals = strchr(*variable, '=');
+        encoded = pair(&params, length, &capacity, *variable, equals - *variable, equals + 1, strlen(equals + 1));
+    }
+    free(envp);
+    if (!encoded)
+    {
+        free(params);
+        return NULL;
+    }
+
+    // frame request as records: FCGI_BEGIN_REQUEST (keeping connection open), pairs as FCGI_PARAMS,
+    // then empty FCGI_PARAMS and FCGI_STDIN to end both streams, all as request 1 (backends serve one at a time)
+    size_t records = (*length + FCGI_CONTENT - 1) / FCGI_CONTENT;
+    size_t total = 16 + records * 8 + *length + 16;
+    octet* message = malloc(total);
+    if (message == NULL)
+    {
+        free(params);
+        return NULL;
+    }
+    octet* m = message;
+    memcpy(m, (octet[]) {FCGI_VERSION_1, FCGI_BEGIN_REQUEST, 0, 1, 0, 8, 0, 0, 0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0}, 16);
+    m += 16;
+    for (size_t offset = 0; offset < *length; offset += FCGI_CONTENT)
+    {
+        size_t n = (*length - offset < FCGI_CONTENT) ? *length - offset : FCGI_CONTENT;
+        memcpy(m, (octet[]) {FCGI_VERSION_1, FCGI_PARAMS, 0, 1, (octet) (n >> 8), (octet) n, 0, 0}, 8);
+        memcpy(m + 8, params + offset, n);
+        m += 8 + n;
+    }
+    memcpy(m, (octet[]) {FCGI_VERSION_1, FCGI_PARAMS, 0, 1, 0, 0, 0, 0, FCGI_VERSION_1, FCGI_STDIN, 0, 1, 0, 0, 0, 0}, 16);
+    free(params);
+    *length = total;
+    return message;
+}
+
+/**
+ * Finds a free backend in worker's pool, preferring one already connected, else returns NULL.
+ */
+backend* engage(worker* w)
+{
+    backend* b = NULL;
+    for (int i = 0; i < backends; i++)
+    {
+        if (!w->interpreters[i].busy && (b == NULL || w->interpreters[i].fd != -1))
+        {
+            b = &w->interpreters[i];
+        }
+    }
+    return b;
+}
+
+/**
+ * Puts an accepted socket on the queue, unless full. Safe to call from any thread.
+ */
+bool enqueue(int cfd)
+{
+    size_t position = atomic_load_explicit(&accepted.enqueued, memory_order_relaxed);
+    while (true)
+    {
+        slot* s = &accepted.slots[position & (QUEUE - 1)];
+        size_t sequence = atomic_load_explicit(&s->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        // slot is free, so try to claim it
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&accepted.enqueued, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                s->cfd = cfd;
+                atomic_store_explicit(&s->sequence, position + 1, memory_order_release);
+                return true;
+            }
+        }
+
+        // queue is full
+        else if (difference < 0)
+        {
+            return false;
+        }
+
+        // another producer got here first
+        else
+        {
+            position = atomic_load_explicit(&accepted.enqueued, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Maps connection's request for PHP script at path (relative to server's root) with query onto CGI's
+ * meta-variables, followed by request's header fields as HTTP_ variables (save for Proxy, lest a script take it
+ * for HTTP_PROXY), as NAME=value strings, NULL-terminated, in one allocation. Returns them, else NULL.
+ */
+char** environment(connection* c, const char* path, const char* query)
+{
+    // map request onto CGI's meta-variables
+    // http://tools.ietf.org/html/rfc3875#section-4.1
+    struct sockaddr_in peer;
+    socklen_t peerlen = sizeof(peer);
+    char address[INET_ADDRSTRLEN] = "";
+    char port[8] = "";
+    if (getpeername(c->cfd, (struct sockaddr*) &peer, &peerlen) == 0 && peer.sin_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &peer.sin_addr, address, sizeof(address));
+        snprintf(port, sizeof(port), "%u", ntohs(peer.sin_port));
+    }
+    errno = 0;
+    char server[8];
+    snprintf(server, sizeof(server), "%i", listening);
+    char script[strlen(path) + 2];
+    sprintf(script, "/%s", path);
+    char filename[strlen(root) + strlen(path) + 2];
+    sprintf(filename, "%s/%s", root, path);
+    char uri[strlen(script) + strlen(query) + 2];
+    sprintf(uri, (query[0] != '\0') ? "%s?%s" : "%s", script, query);
+    const char* variables[][2] =
+    {
+        {"GATEWAY_INTERFACE", "CGI/1.1"},
+        {"SERVER_PROTOCOL", "HTTP/1.1"},
+        {"SERVER_PORT", server},
+        {"REQUEST_METHOD", "GET"},
+        {"REQUEST_URI", uri},
+        {"SCRIPT_NAME", script},
+        {"SCRIPT_FILENAME", filename},
+        {"DOCUMENT_ROOT", root},
+        {"QUERY_STRING", query},
+        {"REMOTE_ADDR", address},
+        {"REMOTE_PORT", port},
+        {"REDIRECT_STATUS", "200"}
+    };
+    int count = sizeof(variables) / sizeof(variables[0]);
+
+    // measure strings, so that they can follow their pointers in one allocation
+    size_t size = (count + c->parser.fields + 1) * sizeof(char*);
+    for (int i = 0; i < count; i++)
+    {
+        size += strlen(variables[i][0]) + strlen(variables[i][1]) + 2;
+    }
+    for (int i = 0; i < c->parser.fields; i++)
+    {
+        size += 5 + c->parser.names[i].length + c->parser.values[i].length + 2;
+    }
+    char** envp = malloc(size);
+    if (envp == NULL)
+    {
+        return NULL;
+    }
+
+    char* string = (char*) (envp + count + c->parser.fields + 1);
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        envp[n++] = string;
+        string += sprintf(string, "%s=%s", variables[i][0], variables[i][1]) + 1;
+    }
+    for (int i = 0; i < c->parser.fields; i++)
+    {
+        view name = c->parser.names[i];
+        view value = c->parser.values[i];
+        if (name.length == 5 && strncasecmp(c->request + name.offset, "Proxy", 5) == 0)
+        {
+            continue;
+        }
+        envp[n++] = string;
+        memcpy(string, "HTTP_", 5);
+        string += 5;
+        for (size_t j = 0; j < name.length; j++)
+        {
+            octet o = c->request[name.offset + j];
+            *string++ = (o == '-') ? '_' : toupper((unsigned char) o);
+        }
+        *string++ = '=';
+        memcpy(string, c->request + value.offset, value.length);
+        string += value.length;
+        *string++ = '\0';
+    }
+    envp[n] = NULL;
+    return envp;
+}
+
+/**
+ * Handles client errors (4xx) and server errors (5xx).
+ */
+bool error(connection* c, unsigned short code)
+{
+    // ensure client's socket is open
+    if (c->cfd == -1)
+    {
+        return false;
+    }
+
+    // ensure code is within range, and that its response has been pre-rendered
+    status* s = describe(code);
+    if (code < 400 || code > 599 || s == NULL || s->tail == NULL)
+    {
+        return false;
+    }
+
+    // discard any partial response, keeping those batched before it
+    release(c, c->begun);
+    c->size = c->start;
+
+    // respond with Status-Line and headers that vary
+    if (!preface(c, s))
+    {
+        return false;
+    }
+
+    // respond with headers that don't, CRLF, and message-body
+    if (!append(c, s->tail, s->taillen))
+    {
+        return false;
+    }
+
+    // announce Response-Line
+    printf("\033[31m");
+    printf("HTTP/1.1 %i %s", code, s->phrase);
+    printf("\033[39m\n");
+
+    return true;
+}
+
+/**
+ * Appends a 206 response with ranges of a file (from cache if e isn't NULL, else from connection's file),
+ * one range alone or several as multipart/byteranges, or, if no range is satisfiable (count is -1), a 416 response.
+ * http://www.w3.org/Protocols/rfc2616/rfc2616-sec19.html#sec19.2
+ */
+bool excerpt(connection* c, entry* e, const char* validators, size_t length, const char* type, size_t size,
+    range* ranges, int count)
+{
+    // no range is satisfiable, so say what is
+    if (count == -1)
+    {
+        status* s = describe(416);
+        if (!preface(c, s) || !format(c, "Content-Range: bytes */%zu\r\n", size) || !append(c, s->tail, s->taillen))
+        {
+            return false;
+        }
+        printf("\033[31m");
+        printf("HTTP/1.1 %i %s", s->code, s->phrase);
+        printf("\033[39m\n");
+        return true;
+    }
+
+    // Status-Line and file's validators
+    if (!preface(c, describe(206)))
+    {
+        return false;
+    }
+    if ((e != NULL) ? !attach(c, e, 0, length) : !append(c, validators, length))
+    {
+        return false;
+    }
+
+    // one range, referring to cached file's contents or sent from file after headers
+    if (count == 1)
+    {
+        size_t first = ranges[0].first, n = ranges[0].last - ranges[0].first + 1;
+        if (!format(c, "Content-Range: bytes %zu-%zu/%zu\r\nContent-Length: %zu\r\nContent-Type: %s\r\n\r\n",
+            first, ranges[0].last, size, n, type))
+        {
+            return false;
+        }
+        if (e != NULL)
+        {
+            if (!attach(c, e, (e->content - e->block) + first, n))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            c->offset = first;
+            c->pending = n;
+        }
+    }
+
+    // several ranges, each copied into response after a boundary and headers of its own
+    else
+    {
+        const char* template = "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %zu-%zu/%zu\r\n\r\n";
+        size_t total = strlen("\r\n----\r\n") + strlen(boundary);
+        for (int i = 0; i < count; i++)
+        {
+            total += snprintf(NULL, 0, template, boundary, type, ranges[i].first, ranges[i].last, size);
+            total += ranges[i].last - ranges[i].first + 1;
+        }
+        if (!format(c, "Content-Length: %zu\r\nContent-Type: multipart/byteranges; boundary=%s\r\n\r\n", total, boundary))
+        {
+            return false;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            size_t first = ranges[i].first, n = ranges[i].last - ranges[i].first + 1;
+            if (!format(c, template, boundary, type, first, ranges[i].last, size))
+            {
+                return false;
+            }
+            if (e != NULL)
+            {
+                if (!append(c, e->content + first, n))
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (!reserve(c, n))
+            {
+                return false;
+            }
+            for (size_t octets = 0; octets < n; )
+            {
+                ssize_t read = pread(fileno(c->file), c->response + c->size + octets, n - octets, first + octets);
+                if (read <= 0)
+                {
+                    errno = 0;
+                    return false;
+                }
+                octets += read;
+            }
+            if (!attach(c, NULL, c->size, n))
+            {
+                return false;
+            }
+            c->size += n;
+        }
+        if (!format(c, "\r\n--%s--\r\n", boundary))
+        {
+            return false;
+        }
+    }
+    announce(describe(206));
+    return true;
+}
+
+/**
+ * Closes worker's connections that have been idle for longer than timeout (or lingered for longer than LINGER),
+ * gives up on scripts that have run for longer than gateway's, and reaps php-cgi processes that have since exited.
+ */
+void expire(worker* w)
+{
+    connection* c = w->connections;
+    int soonest = (timeout < gateway) ? timeout : gateway;
+    while (c != NULL && w->now - c->active > ((soonest < LINGER) ? soonest : LINGER))
+    {
+        connection* next = c->next;
+
+        // connections waiting for scripts aren't idle, though scripts may run out of time, unless it's their clients
+        // that are yet to take scripts' output, whereupon they're idle like any other
+        if (c->state == WAITING)
+        {
+            bool idle = c->streaming && (c->queued > 0 || c->spliced > 0);
+            if (w->now - c->active <= (idle ? timeout : gateway))
+            {
+                c = next;
+                continue;
+            }
+            if (!idle)
+            {
+                abandon(c);
+                c = next;
+                continue;
+            }
+        }
+        else if (w->now - c->active <= ((c->state == LINGERING) ? LINGER : timeout))
+        {
+            c = next;
+            continue;
+        }
+#ifdef HAVE_LIBURING
+        // with io_uring, cancel whatever's in flight first
+        if (uring)
+        {
+            c->state = CLOSING;
+            proceed(c);
+            c = next;
+            continue;
+        }
+#endif
+        reset(c);
+        c = next;
+    }
+    for (int i = 0; i < w->exits;)
+    {
+        if (waitpid(w->exiting[i], NULL, WNOHANG) != 0)
+        {
+            w->exiting[i] = w->exiting[--w->exits];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    errno = 0;
+    w->swept = w->now;
+}
+
+/**
+ * Finds value of request's header field with given name, case-insensitively.
+ */
+bool field(connection* c, const char* name, view* value)
+{
+    size_t length = strlen(name);
+    for (int i = 0; i < c->parser.fields; i++)
+    {
+        view n = c->parser.names[i];
+        if (n.length == length && strncasecmp(c->request + n.offset, name, length) == 0)
+        {
+            *value = c->parser.values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Writes as much of connection's responses as client's socket will take, all at once,
+ * then sends any file that follows them straight from its descriptor,
+ * emptying responses once they've been written.
+ * Returns 1 once responses have been written, 0 if socket would block, -1 on failure.
+ */
+int flush(connection* c)
+{
+    // write responses' parts, holding back a partial segment if a file's to follow
+    while (c->first < c->parts)
+    {
+        struct iovec vectors[SEGMENTS];
+        struct msghdr message = {.msg_iov = vectors, .msg_iovlen = gather(c, vectors)};
+        ssize_t octets = sendmsg(c->cfd, &message, (c->pending > 0 || c->spliced > 0) ? MSG_MORE : 0);
+        if (octets == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                errno = 0;
+                return 0;
+            }
+            errno = 0;
+            return -1;
+        }
+        advance(c, octets);
+    }
+
+    // send file without copying it through userspace
+    while (c->pending > 0)
+    {
+        ssize_t octets = sendfile(c->cfd, fileno(c->file), &c->offset, c->pending);
+        if (octets == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                errno = 0;
+                return 0;
+            }
+            errno = 0;
+            return -1;
+        }
+
+        // file shrank since its length was announced
+        if (octets == 0)
+        {
+            return -1;
+        }
+        c->pending -= octets;
+    }
+
+    // likewise script's output, from php-cgi's pipe
+    while (c->spliced > 0)
+    {
+        ssize_t octets = splice(c->gfd, NULL, c->cfd, NULL, c->spliced, SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+        if (octets == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                errno = 0;
+                return 0;
+            }
+            errno = 0;
+            return -1;
+        }
+        if (octets == 0)
+        {
+            return -1;
+        }
+        c->spliced -= octets;
+    }
+    empty(c);
+    return 1;
+}
+
+/**
+ * Hashes extension, ignoring its case, with FNV-1a from a basis varied by seed,
+ * mixing high bits into low ones since tables are indexed by the latter.
+ */
+uint64_t fold(const char* extension, uint32_t seed)
+{
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (const unsigned char* p = (const unsigned char*) extension; *p != '\0'; p++)
+    {
+        h = (h ^ tolower(*p)) * 1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+/**
+ * Returns true if client's copy of a file is current, per request's If-None-Match (compared weakly against
+ * ETag among file's pre-rendered validators) or, failing that, its If-Modified-Since.
+ * http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.26
+ */
+bool fresh(connection* c, const char* validators, size_t length, time_t modified)
+{
+    // If-None-Match takes precedence over If-Modified-Since
+    view value;
+    if (field(c, "If-None-Match", &value))
+    {
+        // file's entity-tag, quotes and all
+        const char* tag = validators + strlen("ETag: ");
+        const char* end = memchr(tag, '\r', length - strlen("ETag: "));
+        size_t taglen = end - tag;
+
+        // compare each of client's entity-tags (or "*") with file's, ignoring any W/
+        const octet* item = c->request + value.offset;
+        const octet* stop = item + value.length;
+        while (item < stop)
+        {
+            const octet* comma = memchr(item, ',', stop - item);
+            const octet* last = (comma != NULL) ? comma : stop;
+            while (item < last && (*item == ' ' || *item == '\t'))
+            {
+                item++;
+            }
+            while (last > item && (last[-1] == ' ' || last[-1] == '\t'))
+            {
+                last--;
+            }
+            if (last - item >= 2 && strncmp(item, "W/", 2) == 0)
+            {
+                item += 2;
+            }
+            if ((last - item == 1 && *item == '*') || (last - item == (ptrdiff_t) taglen && memcmp(item, tag, taglen) == 0))
+            {
+                return true;
+            }
+            item = (comma != NULL) ? comma + 1 : stop;
+        }
+        return false;
+    }
+
+    // file mustn't have been modified since client's date (at a second's resolution, like Last-Modified)
+    if (field(c, "If-Modified-Since", &value))
+    {
+        time_t since = timestamp(c, value);
+        return since != -1 && since >= modified;
+    }
+    return false;
+}
+
+/**
+ * Removes entry from cache, deallocating it once no response refers to it. Cache's lock must be held.
+ */
+void forget(entry* e)
+{
+    // unlink from bucket
+    entry** link = &buckets[hash(e->path) & (BUCKETS - 1)];
+    while (*link != e)
+    {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+
+    // unlink from list of entries
+    if (e->prev != NULL)
+    {
+        e->prev->next = e->next;
+    }
+    else
+    {
+        oldest = e->next;
+    }
+    if (e->next != NULL)
+    {
+        e->next->prev = e->prev;
+    }
+    else
+    {
+        newest = e->prev;
+    }
+
+    // free entry, unless responses have yet to send it
+    cached -= e->length;
+    if (e->references > 0)
+    {
+        e->forgotten = true;
+    }
+    else
+    {
+        discard(e);
+    }
+}
+
+/**
+ * Appends formatted text to connection's response, straight into its buffer's spare room if there's enough.
+ */
+bool format(connection* c, const char* template, ...)
+{
+    // format into spare room
+    va_list ap;
+    va_start(ap, template);
+    int length = vsnprintf((char*) c->response + c->size, c->reserved - c->size, template, ap);
+    va_end(ap);
+    if (length < 0)
+    {
+        return false;
+    }
+
+    // if there wasn't enough, make room, leaving room for vsnprintf's terminator, and format again
+    if (c->size + length >= c->reserved)
+    {
+        if (!reserve(c, length + 1))
+        {
+            return false;
+        }
+        va_start(ap, template);
+        vsnprintf((char*) c->response + c->size, length + 1, template, ap);
+        va_end(ap);
+    }
+    if (!attach(c, NULL, c->size, length))
+    {
+        return false;
+    }
+    c->size += length;
+    return true;
+}
+
+/**
+ * Describes connection's unwritten parts of responses as vectors for writev and the like.
+ * Returns number of vectors.
+ */
+int gather(connection* c, struct iovec* vectors)
+{
+    int count = 0;
+    for (int i = c->first; i < c->parts; i++)
+    {
+        segment* s = &c->segments[i];
+        octet* base = ((s->file != NULL) ? s->file->block : c->response) + s->offset;
+        size_t skip = (i == c->first) ? c->sent : 0;
+        vectors[count].iov_base = base + skip;
+        vectors[count].iov_len = s->length - skip;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Ensures connection's buffer has room for as many more octets, doubling it as needed
+ * up to the most that a request's headers can span.
+ */
+bool grow(connection* c, size_t octets)
+{
+    if (c->capacity - c->length >= octets)
+    {
+        return true;
+    }
+    if (c->length + octets > REQUEST)
+    {
+        return false;
+    }
+    size_t capacity = (c->capacity == 0) ? OCTETS * 8 : c->capacity * 2;
+    while (capacity < c->length + octets)
+    {
+        capacity *= 2;
+    }
+    if (capacity > REQUEST)
+    {
+        capacity = REQUEST;
+    }
+    octet* request = realloc(c->request, capacity);
+    if (request == NULL)
+    {
+        return false;
+    }
+    c->request = request;
+    c->capacity = capacity;
+    return true;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Compresses length octets with gzip, charging CPU time spent against this process's allowance.
+ * Returns compressed octets (which caller must free), their length in compressed,
+ * or NULL if they're no smaller than octets or can't be compressed.
+ */
+octet* gzip(const octet* octets, size_t length, size_t* compressed)
+{
+    if (length > UINT_MAX)
+    {
+        return NULL;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    // window of 15 bits, plus 16 for a gzip (rather than zlib) wrapper
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return NULL;
+    }
+    size_t bound = deflateBound(&z, length);
+    octet* output = malloc(bound);
+    int result = Z_MEM_ERROR;
+    if (output != NULL)
+    {
+        z.next_in = (Bytef*) octets;
+        z.avail_in = length;
+        z.next_out = (Bytef*) output;
+        z.avail_out = bound;
+        result = deflate(&z, Z_FINISH);
+    }
+    *compressed = z.total_out;
+    deflateEnd(&z);
+
+    // account for time spent, whether or not it paid off
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    unsigned long microseconds = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    atomic_fetch_add(&spent, microseconds);
+    counters* s = &stats[self + 1];
+    atomic_fetch_add_explicit(&s->compressions, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->compressing, microseconds, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->uncompressed, length, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->compressed, (result == Z_STREAM_END) ? *compressed : length, memory_order_relaxed);
+    if (result != Z_STREAM_END || *compressed >= length)
+    {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+#endif
+
+/**
+ * Hashes a path (with FNV-1a).
+ */
+uint64_t hash(const char* path)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*) path; *p != '\0'; p++)
+    {
+        h = (h ^ *p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Removes file at path (relative to server's root) from cache, and path from cache of paths found missing,
+ * or, if path is NULL, every file and every path.
+ */
+void invalidate(const char* path)
+{
+    pthread_mutex_lock(&lock);
+    atomic_fetch_add(&generation, 1);
+    if (path == NULL)
+    {
+        while (oldest != NULL)
+        {
+            forget(oldest);
+        }
+        for (size_t i = 0; i < ABSENCES; i++)
+        {
+            free(absences[i].path);
+            absences[i].path = NULL;
+        }
+    }
+    else
+    {
+        // forget file along with any variant of it compressed on the fly
+        for (entry* e = buckets[hash(path) & (BUCKETS - 1)], *next; e != NULL; e = next)
+        {
+            next = e->chain;
+            if (strcmp(e->path, path) == 0)
+            {
+                forget(e);
+            }
+        }
+        uint64_t h = hash(path);
+        absence* a = &absences[h & (ABSENCES - 1)];
+        if (a->path != NULL && a->hash == h && strcmp(a->path, path) == 0)
+        {
+            free(a->path);
+            a->path = NULL;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Creates this process's event loops, starting worker threads if any.
+ */
+void launch(void)
+{
+    // prepare queue of accepted sockets, each slot's sequence being the position it awaits
+    for (size_t i = 0; i < QUEUE; i++)
+    {
+        atomic_init(&accepted.slots[i].sequence, i);
+    }
+    atomic_init(&accepted.enqueued, 0);
+    atomic_init(&accepted.dequeued, 0);
+
+    // create one event loop per worker thread, or one for main thread
+    int n = (threads == 0) ? 1 : threads;
+    workers = calloc(n, sizeof(worker));
+    if (workers == NULL)
+    {
+        stop();
+    }
+    for (int i = 0; i < n; i++)
+    {
+        workers[i].now = workers[i].swept = time(NULL);
+        stamp(&workers[i]);
+        recruit(&workers[i]);
+        workers[i].efd = epoll_create1(EPOLL_CLOEXEC);
+        if (workers[i].efd == -1)
+        {
+            stop();
+        }
+        workers[i].wfd = eventfd(0, uring ? EFD_CLOEXEC : EFD_NONBLOCK | EFD_CLOEXEC);
+        if (workers[i].wfd == -1)
+        {
+            stop();
+        }
+
+#ifdef HAVE_LIBURING
+        // with io_uring, set up ring instead of registering with epoll
+        if (uring)
+        {
+            prime(&workers[i]);
+            continue;
+        }
+#endif
+
+        // watch eventfd for sockets handed over by main thread
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = &workers[i];
+        if (epoll_ctl(workers[i].efd, EPOLL_CTL_ADD, workers[i].wfd, &event) == -1)
+        {
+            stop();
+        }
+    }
+
+    // without worker threads, main thread's loop watches server's socket for incoming connections
+    if (threads == 0 && !uring)
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = NULL;
+        if (epoll_ctl(workers[0].efd, EPOLL_CTL_ADD, sfd, &event) == -1)
+        {
+            stop();
+        }
+    }
+
+    // otherwise start worker threads, leaving signals to main thread
+    else if (threads > 0)
+    {
+        sigset_t set, old;
+        sigfillset(&set);
+        pthread_sigmask(SIG_BLOCK, &set, &old);
+        for (int i = 0; i < threads; i++)
+        {
+            errno = pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+            if (errno != 0)
+            {
+                stop();
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+
+    // index server's root, and watch it from a thread of its own, so that cached files are invalidated
+    // (and index updated) as they change
+    if (budget > 0 || indexed)
+    {
+        nfd = inotify_init1(IN_CLOEXEC);
+        if (nfd == -1)
+        {
+            stop();
+        }
+        nftw(root, survey, 16, FTW_PHYS);
+        sigset_t set, old;
+        sigfillset(&set);
+        pthread_sigmask(SIG_BLOCK, &set, &old);
+        pthread_t thread;
+        errno = pthread_create(&thread, NULL, watch, NULL);
+        if (errno != 0)
+        {
+            stop();
+        }
+        pthread_detach(thread);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+}
+
+/**
+ * Closes connection's sending side once its last response is written, lingering until client closes its own
+ * (or for LINGER seconds) to discard what client still sends, since closing a socket with octets unread resets
+ * connection, whereupon client may lose response before reading it.
+ */
+void linger(connection* c)
+{
+    if (shutdown(c->cfd, SHUT_WR) == -1)
+    {
+        errno = 0;
+        c->state = CLOSING;
+        return;
+    }
+    touch(c);
+    c->state = LINGERING;
+}
+
+/**
+ * Creates a socket bound to port, listening for connections if asked to.
+ */
+int listener(short port, bool listens)
+{
+    // create a non-blocking socket
+    int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); // Creates the server socket
+    if (sfd == -1)
+    {
+        stop();
+    }
+
+    // allow reuse of address (to avoid "Address already in use")
+    int optval = 1;
+    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+    // with worker processes, let each bind its own socket to the same port,
+    // the kernel then spreading incoming connections across them
+    if (processes > 0)
+    {
+        setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+    }
+
+    // assign name to socket
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr)); // initiaize to 0
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port); // transform from host to network (little endian to big endian)
+    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY); // the same for the server address
+    if (bind(sfd, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) == -1) // Assigning the address to the socket.
+    {
+        stop();
+    }
+
+    // listen for connections
+    if (listens && listen(sfd, SOMAXCONN) == -1)
+    {
+        stop();
+    }
+    return sfd;
+}
+
+/**
+ * Finds file at path (relative to server's root) in cache, else returns NULL.
+ * Cache's lock must be held.
+ */
+entry* locate(const char* path, const char* encoding)
+{
+    for (entry* e = buckets[hash(path) & (BUCKETS - 1)]; e != NULL; e = e->chain)
+    {
+        if (strcmp(e->path, path) == 0 && ((e->encoding == NULL) ? encoding == NULL : encoding != NULL && strcmp(e->encoding, encoding) == 0))
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Handles signals.
+ */
+void handler(int signal)
+{
+    // control-c
+    if (signal == SIGINT)
+    {
+        errno = 0;
+
+        // announce stop
+        printf("\033[33m");
+        printf("Stopping server\n");
+        printf("\033[39m");
+
+        // stop server
+        stop();
+    }
+
+    // report connections accepted so far
+    else if (signal == SIGUSR1)
+    {
+        report();
+    }
+}
+
+/**
+ * Returns MIME type for extension, if known, else NULL, with one probe of perfect hash table
+ * (ignoring extension's case).
+ */
+const char* lookup(const char* extension)
+{
+    if (mappings == NULL)
+    {
+        return NULL;
+    }
+    uint32_t displacement = displacements[fold(extension, 0) & (groups - 1)];
+    mapping* m = &mappings[fold(extension, displacement + 1) & (spread - 1)];
+    return (m->extension != NULL && strcasecmp(m->extension, extension) == 0) ? m->type : NULL;
+}
+
+/**
+ * Runs a worker's event loop forever, serving every connection a little at a time
+ * rather than one after another.
+ */
+void loop(worker* w)
+{
+    struct epoll_event events[EVENTS];
+    while (true)
+    {
+        // wake at least once a second to close idle connections
+        int n = epoll_wait(w->efd, events, EVENTS, 1000);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                errno = 0;
+                continue;
+            }
+            stop();
+        }
+        w->now = time(NULL);
+        if (w->now != w->swept)
+        {
+            // render Date header for new second
+            stamp(w);
+            expire(w);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            // server's socket is registered without a connection
+            connection* c = (connection*) (uintptr_t) (events[i].data.u64 & ~(uint64_t) GATEWAY);
+            if (c == NULL)
+            {
+                connected(w);
+                continue;
+            }
+
+            // worker's eventfd is registered with the worker itself
+            if ((void*) c == (void*) w)
+            {
+                uint64_t count;
+                if (read(w->wfd, &count, sizeof(count)) == -1)
+                {
+                    errno = 0;
+                }
+                int cfd;
+                while (dequeue(&cfd))
+                {
+                    adopt(w, cfd);
+                }
+                continue;
+            }
+
+            // ignore connections closed while handling earlier events
+            if (c->cfd == -1)
+            {
+                continue;
+            }
+
+            // note activity, though a script's time runs until its output streams (and is taken by its client),
+            // and lingering lasts no longer than LINGER however much client sends
+            if ((c->state != WAITING || c->streaming) && c->state != LINGERING)
+            {
+                touch(c);
+            }
+
+            // script's output arrived
+            if (events[i].data.u64 & GATEWAY)
+            {
+                c->drained = false;
+                serve(c);
+                continue;
+            }
+
+            // client hung up or socket failed (though a client that only shut down its sending half, as it may,
+            // still gets its response, script's output included)
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                reset(c);
+                continue;
+            }
+
+            // advance connection's state machine
+            serve(c);
+        }
+        bury(w);
+    }
+}
+
+/**
+ * Caches path (relative to server's root) as missing, replacing whichever path shared its slot, unless files
+ * have been invalidated since path was found missing (in which case it may have since appeared).
+ */
+void mark(const char* path, unsigned long before, time_t now)
+{
+    size_t length = strlen(path);
+    if (budget == 0 || length > ABSENT || !canonical(path))
+    {
+        return;
+    }
+    char* copy = malloc(length + 1);
+    if (copy == NULL)
+    {
+        return;
+    }
+    memcpy(copy, path, length + 1);
+    uint64_t h = hash(path);
+    absence* a = &absences[h & (ABSENCES - 1)];
+    pthread_mutex_lock(&lock);
+    if (atomic_load(&generation) != before)
+    {
+        pthread_mutex_unlock(&lock);
+        free(copy);
+        return;
+    }
+    free(a->path);
+    a->path = copy;
+    a->hash = h;
+    a->expires = now + FORGET;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Notes whether directory (relative to server's root) goes unwatched, whereupon files within it aren't cached.
+ */
+void neglect(const char* directory, bool neglected)
+{
+    pthread_mutex_lock(&lock);
+    int i = 0;
+    while (i < unwatchables && strcmp(unwatched[i], directory) != 0)
+    {
+        i++;
+    }
+    if (neglected && i == unwatchables)
+    {
+        char** grown = realloc(unwatched, (unwatchables + 1) * sizeof(char*));
+        if (grown != NULL)
+        {
+            unwatched = grown;
+            unwatched[unwatchables] = strdup(directory);
+            if (unwatched[unwatchables] != NULL)
+            {
+                unwatchables++;
+            }
+        }
+    }
+    else if (!neglected && i < unwatchables)
+    {
+        free(unwatched[i]);
+        unwatched[i] = unwatched[--unwatchables];
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Returns true if changes to file at path (relative to server's root), open as fd, would be noticed, so that it
+ * can be cached: if path leads to it without symbolic links (whose targets might lie outside server's root),
+ * and if it's not within a directory that couldn't be watched.
+ */
+bool observed(const char* path, int fd)
+{
+    // compare file's path, as kernel resolved it, with root's followed by path
+    size_t prefix = strlen(root);
+    if (root[prefix - 1] == '/')
+    {
+        prefix--;
+    }
+    size_t length = prefix + 1 + strlen(path);
+    char link[32];
+    sprintf(link, "/proc/self/fd/%i", fd);
+    char resolved[length + 1];
+    ssize_t n = readlink(link, resolved, length + 1);
+    if (n == -1)
+    {
+        errno = 0;
+        return false;
+    }
+    if ((size_t) n != length || strncmp(resolved, root, prefix) != 0 || resolved[prefix] != '/' ||
+        strncmp(resolved + prefix + 1, path, length - prefix - 1) != 0)
+    {
+        return false;
+    }
+
+    // look for a directory containing file among those unwatched
+    bool watched = true;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < unwatchables && watched; i++)
+    {
+        size_t m = strlen(unwatched[i]);
+        watched = m > 0 && !(strncmp(path, unwatched[i], m) == 0 && path[m] == '/');
+    }
+    pthread_mutex_unlock(&lock);
+    return watched;
+}
+
+/**
+ * Appends a name-value pair, encoded as FastCGI's FCGI_PARAMS stream encodes them (each length in 1 octet
+ * if under 128, else in 4 with the high bit set), to params, growing it as needed.
+ */
+bool pair(octet** params, size_t* length, size_t* capacity, const char* name, size_t namelen, const char* value, size_t valuelen)
+{
+    size_t needed = *length + 8 + namelen + valuelen;
+    if (needed > *capacity)
+    {
+        size_t bigger = (*capacity == 0) ? OCTETS * 2 : *capacity;
+        while (bigger < needed)
+        {
+            bigger *= 2;
+        }
+        octet* p = realloc(*params, bigger);
+        if (p == NULL)
+        {
+            return false;
+        }
+        *params = p;
+        *capacity = bigger;
+    }
+    octet* p = *params + *length;
+    size_t lengths[] = {namelen, valuelen};
+    for (int i = 0; i < 2; i++)
+    {
+        if (lengths[i] < 128)
+        {
+            *p++ = lengths[i];
+        }
+        else
+        {
+            *p++ = (octet) (0x80 | (lengths[i] >> 24));
+            *p++ = (octet) (lengths[i] >> 16);
+            *p++ = (octet) (lengths[i] >> 8);
+            *p++ = (octet) lengths[i];
+        }
+    }
+    memcpy(p, name, namelen);
+    memcpy(p + namelen, value, valuelen);
+    *length = p + namelen + valuelen - *params;
+    return true;
+}
+
+/**
+ * Parses an HTTP request. // it reads not from a file, but from a network connection
+ * Reads whatever the client's socket has to offer without blocking, straight into connection's buffer.
+ * Returns length of request's headers once parsed, 0 if more octets are needed,
+ * -1 on failure (in which case an error may have been queued as the response).
+ */
+ssize_t parse(connection* c)
+{
+    // ensure client's socket is open
+    if (c->cfd == -1)
+    {
+        return -1;
+    }
+
+    // parse any octets left over from previous request first
+    if (c->parser.position < c->length)
+    {
+        ssize_t length = resume(c);
+        if (length != 0)
+        {
+            return length;
+        }
+    }
+
+    // parse request
+    while (true)
+    {
+        // ensure there's room to read into
+        if (!grow(c, 1))
+        {
+            error(c, 413);
+            return -1;
+        }
+
+        // read from socket
+        ssize_t octets = read(c->cfd, c->request + c->length, c->capacity - c->length);
+        if (octets == -1)
+        {
+            // nothing more to read for now
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                errno = 0;
+                return 0;
+            }
+            errno = 0;
+            error(c, 500);
+            return -1;
+        }
+
+        // client closed connection
+        if (octets == 0)
+        {
+            return -1;
+        }
+
+        // parse octets read
+        c->length += octets;
+        ssize_t length = resume(c);
+        if (length != 0)
+        {
+            return length;
+        }
+    }
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * Sets up a worker's io_uring instance and ring of buffers, then arms its first submission.
+ */
+void prime(worker* w)
+{
+    errno = -io_uring_queue_init(ENTRIES, &w->ring, 0);
+    if (errno != 0)
+    {
+        stop();
+    }
+
+    // ring of buffers into which the kernel receives clients' octets
+    w->pool = malloc(BUFFERS * BUFFER);
+    if (w->pool == NULL)
+    {
+        stop();
+    }
+    int ret;
+    w->buffers = io_uring_setup_buf_ring(&w->ring, BUFFERS, 0, 0, &ret);
+    if (w->buffers == NULL)
+    {
+        errno = -ret;
+        stop();
+    }
+    for (int i = 0; i < BUFFERS; i++)
+    {
+        io_uring_buf_ring_add(w->buffers, w->pool + i * BUFFER, BUFFER, i, io_uring_buf_ring_mask(BUFFERS), i);
+    }
+    io_uring_buf_ring_advance(w->buffers, BUFFERS);
+
+    // without worker threads, accept connections on server's socket (in blocking mode, so the ring,
+    // not the socket, decides when to wait), else wait for main thread to hand some over
+    struct io_uring_sqe* sqe = submission(w);
+    if (threads == 0)
+    {
+        fcntl(sfd, F_SETFL, fcntl(sfd, F_GETFL) & ~O_NONBLOCK);
+        io_uring_prep_multishot_accept(sqe, sfd, NULL, NULL, SOCK_CLOEXEC);
+        io_uring_sqe_set_data64(sqe, ACCEPT);
+    }
+    else
+    {
+        io_uring_prep_read(sqe, w->wfd, &w->wakeups, sizeof(w->wakeups), 0);
+        io_uring_sqe_set_data64(sqe, WAKE);
+    }
+}
+
+/**
+ * Advances connection through its states, submitting to io_uring whatever comes next,
+ * answering pipelined requests back to back and sending their responses together.
+ * Connection may have been freed upon return.
+ */
+void proceed(connection* c)
+{
+    worker* w = c->worker;
+    struct io_uring_sqe* sqe;
+    while (true)
+    {
+        // receive requests' headers into worker's ring of buffers
+        if (c->state == READING && !c->armed)
+        {
+            sqe = submission(w);
+            io_uring_prep_recv_multishot(sqe, c->cfd, NULL, 0, 0);
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = 0;
+            io_uring_sqe_set_data64(sqe, (uintptr_t) c | RECV);
+            c->armed = true;
+            c->inflight++;
+        }
+
+        // stop receiving and sending, then close connection once nothing's in flight
+        if (c->state == CLOSING)
+        {
+            if (c->armed || c->inflight > 0)
+            {
+                sqe = submission(w);
+                io_uring_prep_cancel_fd(sqe, c->cfd, IORING_ASYNC_CANCEL_ALL);
+                io_uring_sqe_set_data64(sqe, CANCEL);
+                c->armed = false;
+                if (c->gfd != -1)
+                {
+                    sqe = submission(w);
+                    io_uring_prep_cancel_fd(sqe, c->gfd, IORING_ASYNC_CANCEL_ALL);
+                    io_uring_sqe_set_data64(sqe, CANCEL);
+                }
+            }
+            if (c->inflight == 0)
+            {
+                reset(c);
+            }
+            return;
+        }
+
+        // wait for read or send already in flight, lest response's buffer move beneath it
+        if (c->inflight > (c->armed ? 1 : 0))
+        {
+            return;
+        }
+
+        // empty responses once they've been sent
+        if (c->first == c->parts)
+        {
+            empty(c);
+        }
+
+        // parse what was received of next request while those before it were answered,
+        // unless enough responses already await sending
+        if (c->state == READING && c->parser.position < c->length && !batched(c))
+        {
+            ssize_t length = resume(c);
+            if (length > 0)
+            {
+                c->state = RESPONDING;
+            }
+            else if (length < 0)
+            {
+                // send whatever error resume queued, after responses batched before it
+                c->state = WRITING;
+            }
+        }
+
+        // no whole request remains, so send responses batched so far, then wait for more octets
+        if (c->state == READING)
+        {
+            if (c->first < c->parts)
+            {
+                transmit(c);
+            }
+            return;
+        }
+
+        // send responses batched before script's, then read script's output as it arrives
+        if (c->state == WAITING)
+        {
+            if (c->first < c->parts)
+            {
+                transmit(c);
+            }
+            else if (c->gfd != -1)
+            {
+                if (!widen(c))
+                {
+                    conclude(c, false);
+                    continue;
+                }
+                sqe = submission(w);
+                io_uring_prep_read(sqe, c->gfd, c->body + c->loaded, c->allocated - c->loaded, 0);
+                io_uring_sqe_set_data64(sqe, (uintptr_t) c | RELAY);
+                c->inflight++;
+            }
+            return;
+        }
+
+        // build response
+        if (c->state == RESPONDING)
+        {
+            respond(c);
+            if (c->state == WAITING)
+            {
+                continue;
+            }
+            c->state = WRITING;
+        }
+
+        // finish response
+        if (c->state == WRITING)
+        {
+            // read file (or range of it) into response, after headers, a window at a time, sending each window
+            // before reading the next into the same buffer, so that a connection's memory stays bounded however
+            // large the file
+            if (c->pending > 0)
+            {
+                if (c->size >= WINDOW)
+                {
+                    transmit(c);
+                    return;
+                }
+                size_t window = (c->pending < WINDOW) ? c->pending : WINDOW;
+                if (!reserve(c, window))
+                {
+                    c->state = CLOSING;
+                    continue;
+                }
+                sqe = submission(w);
+                io_uring_prep_read(sqe, fileno(c->file), c->response + c->size, window, c->offset);
+                io_uring_sqe_set_data64(sqe, (uintptr_t) c | READ);
+                c->inflight++;
+                return;
+            }
+
+            // move on to next request, if client and server are willing
+            if (c->persistent)
+            {
+                recycle(c);
+                continue;
+            }
+
+            // send what remains of responses, then close connection
+            if (c->first < c->parts)
+            {
+                transmit(c);
+                return;
+            }
+            c->state = CLOSING;
+        }
+    }
+}
+#endif
+
+/**
+ * Reaps php-cgi, else, if it's yet to exit, leaves it for worker to reap once it has.
+ */
+void reap(worker* w, pid_t pid)
+{
+    if (waitpid(pid, NULL, WNOHANG) != 0)
+    {
+        errno = 0;
+        return;
+    }
+    pid_t* exiting = realloc(w->exiting, (w->exits + 1) * sizeof(pid_t));
+    if (exiting == NULL)
+    {
+        return;
+    }
+    w->exiting = exiting;
+    w->exiting[w->exits++] = pid;
+}
+
+/**
+ * Responds with file at path (relative to server's root) from cache, without touching filesystem,
+ * if it's there, cached with the same encoding (NULL for identity). Returns true if so.
+ */
+bool recall(connection* c, const char* path, const char* encoding)
+{
+    if (budget == 0)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&lock);
+    entry* e = locate(path, encoding);
+    if (e == NULL)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    // mark entry as most recently used
+    if (e != newest)
+    {
+        if (e->prev != NULL)
+        {
+            e->prev->next = e->next;
+        }
+        else
+        {
+            oldest = e->next;
+        }
+        e->next->prev = e->prev;
+        e->prev = newest;
+        e->next = NULL;
+        newest->next = e;
+        newest = e;
+    }
+
+    // respond while entry can't be evicted
+    bool delivered = deliver(c, e);
+    pthread_mutex_unlock(&lock);
+    atomic_fetch_add_explicit(&stats[self + 1].hits, 1, memory_order_relaxed);
+    if (!delivered)
+    {
+        error(c, 500);
+    }
+    return true;
+}
+
+/**
+ * Responds with a precompressed variant of a text file at path (relative to server's root), its sidecar
+ * "path.br" or "path.gz", if client accepts that encoding and there is such a sidecar, preferring brotli.
+ * Sidecars are looked up in index if server's root is indexed, else in caches (of files and of paths found
+ * missing) before filesystem. Returns true if so.
+ */
+bool precompressed(connection* c, const char* path, const char* type)
+{
+    static const char* encodings[] = {"br", "gzip"};
+    static const char* suffixes[] = {"br", "gz"};
+    view value;
+    if (type == NULL || !compressible(type) || !field(c, "Accept-Encoding", &value))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++)
+    {
+        if (!accepts(c, value, encodings[i]))
+        {
+            continue;
+        }
+        char sidecar[strlen(path) + strlen(suffixes[i]) + 2];
+        sprintf(sidecar, "%s.%s", path, suffixes[i]);
+
+        // skip sidecars known not to exist
+        if (indexed)
+        {
+            pthread_rwlock_rdlock(&guard);
+            record* r = probe(sidecar);
+            bool readable = (r != NULL && r->readable);
+            pthread_rwlock_unlock(&guard);
+            if (!readable)
+            {
+                continue;
+            }
+        }
+        else if (absent(sidecar, c->worker->now))
+        {
+            continue;
+        }
+
+        // respond with sidecar from cache if there
+        if (recall(c, sidecar, encodings[i]))
+        {
+            return true;
+        }
+
+        // else ensure sidecar exists, caching it as missing if it doesn't
+        if (!indexed)
+        {
+            unsigned long before = atomic_load(&generation);
+            if (faccessat(rfd, sidecar, R_OK, 0) == -1)
+            {
+                if (errno == ENOENT || errno == ENOTDIR)
+                {
+                    mark(sidecar, before, c->worker->now);
+                }
+                errno = 0;
+                continue;
+            }
+        }
+        dispense(c, sidecar, type, encodings[i]);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Appends Status-Line and headers that vary from response to response (Connection, and Date,
+ * as rendered once a second) to connection's response.
+ */
+bool preface(connection* c, status* s)
+{
+    static const char keepalive[] = "Connection: keep-alive\r\n";
+    static const char close[] = "Connection: close\r\n";
+    if (!append(c, s->line, s->linelen))
+    {
+        return false;
+    }
+    if (c->persistent ? !append(c, keepalive, sizeof(keepalive) - 1) : !append(c, close, sizeof(close) - 1))
+    {
+        return false;
+    }
+    return append(c, c->worker->date, c->worker->datelen);
+}
+
+/**
+ * Looks up file at path (relative to server's root) in index. Index's lock must be held.
+ */
+record* probe(const char* path)
+{
+    if (slots == 0)
+    {
+        return NULL;
+    }
+    for (size_t i = hash(path) & (slots - 1); records[i].path != NULL; i = (i + 1) & (slots - 1))
+    {
+        if (records[i].path != vacant && strcmp(records[i].path, path) == 0)
+        {
+            return &records[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Appends octets received from client's socket (by io_uring) to connection's buffer, for proceed to parse.
+ * Returns false if they don't fit.
+ */
+bool receive(connection* c, const octet* octets, size_t length)
+{
+    if (!grow(c, length))
+    {
+        return false;
+    }
+    memcpy(c->request + c->length, octets, length);
+    c->length += length;
+    return true;
+}
+
+/**
+ * Readies connection for its next request, keeping whatever octets of it have already been received
+ * and whatever responses have yet to be written.
+ */
+void recycle(connection* c)
+{
+    // free response's body
+    if (c->body != NULL)
+    {
+        free(c->body);
+        c->body = NULL;
+    }
+    c->loaded = c->allocated = 0;
+    c->streaming = c->chunked = false;
+    c->owing = false;
+
+    // close file
+    if (c->file != NULL)
+    {
+        fclose(c->file);
+        c->file = NULL;
+    }
+
+    // batch next response after this one
+    c->start = c->size;
+    c->begun = c->parts;
+    c->pending = 0;
+    c->offset = 0;
+
+    // move octets that followed request's headers to front of buffer
+    size_t leftover = c->length - c->parser.position;
+    memmove(c->request, c->request + c->parser.position, leftover);
+    c->length = leftover;
+    memset(&c->parser, 0, sizeof(parser));
+
+    c->persistent = false;
+    c->state = READING;
+}
+
+/**
+ * Brings index up to date with file at path (relative to server's root), whether it's appeared, changed or gone.
+ */
+void refresh(const char* path)
+{
+    struct stat info;
+    if (fstatat(rfd, path, &info, 0) == 0 && S_ISREG(info.st_mode))
+    {
+        catalog(path, &info);
+    }
+    else
+    {
+        errno = 0;
+        withdraw(path, false);
+    }
+}
+
+/**
+ * Reads connection's file, at path (relative to server's root), into cache, evicting least recently used files
+ * to make room, then responds with it. Returns false, having responded with nothing, if file can't be cached.
+ */
+bool remember(connection* c, const char* path, const char* type, const char* encoding, const struct stat* info)
+{
+    // cache only regular files small enough, named by their canonical paths, since those are what invalidation names,
+    // and only if their changes would be noticed
+    size_t size = info->st_size;
+    if (budget == 0 || !S_ISREG(info->st_mode) || size > CACHEABLE || size > budget || !canonical(path) ||
+        !observed(path, fileno(c->file)))
+    {
+        return false;
+    }
+
+    // render headers that don't vary from response to response, to be followed by file's contents
+    entry* e = create(path, type, encoding, info, size);
+    if (e == NULL)
+    {
+        return false;
+    }
+
+    // read file, noting how many invalidations preceded it
+    unsigned long before = atomic_load(&generation);
+    size_t octets = 0;
+    while (octets < size)
+    {
+        ssize_t n = pread(fileno(c->file), e->content + octets, size - octets, octets);
+        if (n <= 0)
+        {
+            errno = 0;
+            discard(e);
+            return false;
+        }
+        octets += n;
+    }
+
+    // compress file too, before taking cache's lock, if client accepts it compressed and it's worth compressing
+    entry* z = NULL;
+#ifdef HAVE_ZLIB
+    if (encoding == NULL && size >= DEFLATABLE && compressing(c, type) && affordable())
+    {
+        z = variant(e);
+        e->incompressible = (z == NULL);
+    }
+#endif
+
+    // respond with file (compressed, if it was), caching it (and its variant) unless it's changed since it was read
+    pthread_mutex_lock(&lock);
+    bool delivered = deliver(c, (z != NULL) ? z : e);
+    store(e, before);
+    if (z != NULL)
+    {
+        store(z, before);
+    }
+    pthread_mutex_unlock(&lock);
+    if (!delivered)
+    {
+        error(c, 500);
+    }
+    return true;
+}
+
+/**
+ * Reads script's output from connection's gateway, turning it into response as it arrives (or leaving large runs
+ * of it to be spliced), until gateway has no more for now or enough of response awaits writing, concluding
+ * response once output ends (or gateway fails).
+ */
+void relay(connection* c)
+{
+    // output being spliced must reach client before any more is read
+    if (c->spliced > 0)
+    {
+        return;
+    }
+    while (c->state == WAITING && c->gfd != -1 && !batched(c))
+    {
+        if (!siphon(c) || !widen(c))
+        {
+            conclude(c, false);
+            return;
+        }
+        if (c->spliced > 0)
+        {
+            return;
+        }
+        ssize_t n = (c->backend != NULL) ?
+            recv(c->gfd, c->body + c->loaded, c->allocated - c->loaded, MSG_DONTWAIT) :
+            read(c->gfd, c->body + c->loaded, c->allocated - c->loaded);
+        if (n > 0)
+        {
+            if (absorb(c, n))
+            {
+                conclude(c, true);
+            }
+            else if (!stream(c))
+            {
+                conclude(c, false);
+            }
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            errno = 0;
+            c->drained = true;
+            return;
+        }
+        errno = 0;
+
+        // php-cgi's output ends when it exits, but a backend's only with FCGI_END_REQUEST
+        conclude(c, n == 0 && c->backend == NULL);
+    }
+}
+
+/**
+ * Drops connection's parts of responses from index from on, letting go of any cached files among them.
+ */
+void release(connection* c, int from)
+{
+    bool locked = false;
+    for (int i = from; i < c->parts; i++)
+    {
+        segment* s = &c->segments[i];
+        if (i >= c->first)
+        {
+            c->queued -= s->length - ((i == c->first) ? c->sent : 0);
+        }
+        if (s->file != NULL)
+        {
+            if (!locked)
+            {
+                pthread_mutex_lock(&lock);
+                locked = true;
+            }
+            s->file->references--;
+            if (s->file->references == 0 && s->file->forgotten)
+            {
+                discard(s->file);
+            }
+        }
+    }
+    if (locked)
+    {
+        pthread_mutex_unlock(&lock);
+    }
+    c->parts = from;
+    if (c->first > from)
+    {
+        c->first = from;
+        c->sent = 0;
+    }
+}
+
+/**
+ * Reports how many connections each worker process (or this lone process) has accepted,
+ * and how its cache has fared.
+ */
+void report(void)
+{
+    printf("\033[33m");
+    if (processes == 0)
+    {
+        printf("Accepted %lu connections; cache hits %lu, misses %lu, evictions %lu, absences %lu; "
+            "compressions %lu (%.1f ms of CPU, %lu octets to %lu)", atomic_load(&stats[0].accepts),
+            atomic_load(&stats[0].hits), atomic_load(&stats[0].misses), atomic_load(&stats[0].evictions),
+            atomic_load(&stats[0].absences), atomic_load(&stats[0].compressions), atomic_load(&stats[0].compressing) / 1000.0,
+            atomic_load(&stats[0].uncompressed), atomic_load(&stats[0].compressed));
+    }
+    else
+    {
+        for (int i = 0; i < processes; i++)
+        {
+            printf("%sWorker %i (pid %i) accepted %lu connections; cache hits %lu, misses %lu, evictions %lu, absences %lu; "
+                "compressions %lu (%.1f ms of CPU, %lu octets to %lu)",
+                (i > 0) ? "\n" : "", i, (pids != NULL) ? pids[i] : 0, atomic_load(&stats[i + 1].accepts),
+                atomic_load(&stats[i + 1].hits), atomic_load(&stats[i + 1].misses), atomic_load(&stats[i + 1].evictions),
+                atomic_load(&stats[i + 1].absences), atomic_load(&stats[i + 1].compressions),
+                atomic_load(&stats[i + 1].compressing) / 1000.0, atomic_load(&stats[i + 1].uncompressed),
+                atomic_load(&stats[i + 1].compressed));
+        }
+    }
+    printf("\033[39m\n");
+}
+
+/**
+ * Pre-renders each status's Status-Line and, for errors, the rest of its response,
+ * along with boundary for multipart/byteranges responses.
+ */
+void render(void)
+{
+    // boundary, improbable within any file
+    unsigned long long seed;
+    if (getrandom(&seed, sizeof(seed), 0) != sizeof(seed))
+    {
+        seed = (unsigned long long) time(NULL) ^ getpid();
+        errno = 0;
+    }
+    snprintf(boundary, sizeof(boundary), "%016llx", seed);
+
+    for (size_t i = 0; i < sizeof(statuses) / sizeof(status); i++)
+    {
+        status* s = &statuses[i];
+        int length = asprintf(&s->line, "HTTP/1.1 %i %s\r\n", s->code, s->phrase);
+        if (length == -1)
+        {
+            stop();
+        }
+        s->linelen = length;
+        if (s->code < 400)
+        {
+            continue;
+        }
+
+        // message-body, followed by headers that describe it
+        char* content;
+        int size = asprintf(&content, "<html><head><title>%i %s</title></head><body><h1>%i %s</h1></body></html>",
+            s->code, s->phrase, s->code, s->phrase);
+        if (size == -1)
+        {
+            stop();
+        }
+        length = asprintf(&s->tail, "Content-Length: %i\r\nContent-Type: text/html\r\n\r\n%s", size, content);
+        free(content);
+        if (length == -1)
+        {
+            stop();
+        }
+        s->taillen = length;
+    }
+}
+
+/**
+ * Starts worker's FastCGI backends, each a php-cgi listening on a socket of its own
+ * (in Linux's abstract namespace, so that nothing's left behind on disk).
+ */
+void recruit(worker* w)
+{
+    if (backends == 0)
+    {
+        return;
+    }
+    w->interpreters = calloc(backends, sizeof(backend));
+    if (w->interpreters == NULL)
+    {
+        stop();
+    }
+
+    // have each php-cgi serve connections itself, rather than from children of its own, and indefinitely,
+    // since a backend that exits is only noticed (and restarted) once its connection breaks
+    setenv("PHP_FCGI_CHILDREN", "0", 1);
+    setenv("PHP_FCGI_MAX_REQUESTS", "0", 1);
+
+    for (int i = 0; i < backends; i++)
+    {
+        backend* b = &w->interpreters[i];
+        b->fd = -1;
+
+        // let kernel pick socket's (abstract) address
+        b->lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        b->address.sun_family = AF_UNIX;
+        if (b->lfd == -1 || bind(b->lfd, (struct sockaddr*) &b->address, sizeof(sa_family_t)) == -1 || listen(b->lfd, SOMAXCONN) == -1)
+        {
+            stop();
+        }
+        b->addrlen = sizeof(b->address);
+        if (getsockname(b->lfd, (struct sockaddr*) &b->address, &b->addrlen) == -1)
+        {
+            stop();
+        }
+        summon(b);
+    }
+}
+
+/**
+ * Ensures connection's response buffer has room for as many more octets, doubling it as needed,
+ * so that it's allocated once and reused across responses rather than reallocated for each header.
+ */
+bool reserve(connection* c, size_t octets)
+{
+    if (c->reserved - c->size >= octets)
+    {
+        return true;
+    }
+    size_t reserved = (c->reserved == 0) ? OCTETS * 2 : c->reserved * 2;
+    while (reserved < c->size + octets)
+    {
+        reserved *= 2;
+    }
+    octet* response = realloc(c->response, reserved);
+    if (response == NULL)
+    {
+        return false;
+    }
+    c->response = response;
+    c->reserved = reserved;
+    return true;
+}
+
+/**
+ * Closes connection, deallocating any resources, though connection itself is only freed once its worker
+ * is done with the events at hand.
+ */
+void reset(connection* c)
+{
+    // let go of script's gateway, if any
+    if (c->gfd != -1 || c->framed != NULL)
+    {
+        detach(c, false);
+    }
+#ifdef HAVE_ZLIB
+    seal(c);
+#endif
+
+    // free response's body
+    if (c->body != NULL)
+    {
+        free(c->body);
+        c->body = NULL;
+    }
+
+    // free response, letting go of any cached files it refers to
+    release(c, 0);
+    if (c->response != NULL)
+    {
+        free(c->response);
+        c->response = NULL;
+    }
+
+    // close file
+    if (c->file != NULL)
+    {
+        fclose(c->file);
+        c->file = NULL;
+    }
+
+    // free request
+    if (c->request != NULL)
+    {
+        free(c->request);
+        c->request = NULL;
+    }
+
+    // close client's socket, removing it from epoll first, since closing it alone wouldn't while a php-cgi
+    // that's being forked (and has yet to exec) shares it
+    if (c->cfd != -1)
+    {
+        if (!uring)
+        {
+            epoll_ctl(c->worker->efd, EPOLL_CTL_DEL, c->cfd, NULL);
+        }
+        close(c->cfd);
+        c->cfd = -1;
+    }
+
+    // forget connection
+    if (c->prev != NULL)
+    {
+        c->prev->next = c->next;
+    }
+    else
+    {
+        c->worker->connections = c->next;
+    }
+    if (c->next != NULL)
+    {
+        c->next->prev = c->prev;
+    }
+    else
+    {
+        c->worker->last = c->prev;
+    }
+    c->behind = c->worker->closed;
+    c->worker->closed = c;
+}
+
+/**
+ * Validates a parsed request and queues a response for it.
+ */
+void respond(connection* c)
+{
+    // request-line's parts, as parsed in place in connection's buffer
+    // http://www.w3.org/Protocols/rfc2616/rfc2616-sec5.html
+    parser* p = &c->parser;
+    octet* request = c->request;
+
+    // log request-line
+    printf("%.*s\r\n", (int) (p->version.offset + p->version.length - p->method.offset), request + p->method.offset);
+
+    // close connection afterwards, unless request proves valid
+    c->requests++;
+    c->persistent = false;
+
+    // method must be GET
+    if (p->method.length != 3 || strncmp(request + p->method.offset, "GET", 3) != 0)
+    {
+        error(c, 405);
+        return;
+    }
+
+    // request target must begin with "/"
+    if (request[p->target.offset] != '/')
+    {
+        error(c, 501);
+        return;
+    }
+
+    // request target must not contain "
+    if (memchr(request + p->target.offset, '"', p->target.length) != NULL)
+    {
+        error(c, 400);
+        return;
+    }
+
+    // version must be "HTTP/1.1"
+    if (p->version.length != 8 || strncasecmp(request + p->version.offset, "HTTP/1.1", 8) != 0)
+    {
+        error(c, 505);
+        return;
+    }
+
+    // absolute path must contain "."
+    if (memchr(request + p->path.offset, '.', p->path.length) == NULL)
+    {
+        error(c, 501);
+        return;
+    }
+
+    // terminate path and query in place, over the "?" and " " that follow them
+    request[p->path.offset + p->path.length] = '\0';
+    request[p->target.offset + p->target.length] = '\0';
+    const char* query = (p->query.offset == 0) ? "" : request + p->query.offset;
+
+    // resolve path relative to server's root, rather than concatenating the two
+    const char* path = request + p->path.offset;
+    while (*path == '/')
+    {
+        path++;
+    }
+
+    // path must stay within server's root
+    if (!contained(path))
+    {
+        error(c, 400);
+        return;
+    }
+
+    // keep connection open afterwards, unless client asked otherwise or has made enough requests, or request has
+    // a body, which, unread, would otherwise be parsed as the next request
+    view connection;
+    c->persistent = c->requests < keepalive && !(field(c, "Connection", &connection) && contains(c, connection, "close")) &&
+        !bodied(c);
+
+    // extract path's extension
+    const char* extension = strrchr(path, '.') + 1;
+
+    // respond to requests for paths recently found missing without touching filesystem, unless indexed
+    // (whereupon index answers just as fast)
+    if (!indexed && absent(path, c->worker->now))
+    {
+        atomic_fetch_add_explicit(&stats[self + 1].absences, 1, memory_order_relaxed);
+        error(c, 404);
+        return;
+    }
+
+    // respond with a precompressed sidecar of a text file, from cache if there, if client accepts one and there is one
+    if (strcasecmp("php", extension) != 0 && precompressed(c, path, lookup(extension)))
+    {
+        return;
+    }
+
+#ifdef HAVE_ZLIB
+    // else with a variant of a text file compressed on the fly, if client accepts one and file's cached
+    if (strcasecmp("php", extension) != 0 && condense(c, path, lookup(extension)))
+    {
+        return;
+    }
+#endif
+
+    // respond with static content from cache if there, without touching filesystem, else count a miss (just one,
+    // however many of file's encodings were looked for)
+    if (strcasecmp("php", extension) != 0)
+    {
+        if (recall(c, path, NULL))
+        {
+            return;
+        }
+        if (budget > 0)
+        {
+            atomic_fetch_add_explicit(&stats[self + 1].misses, 1, memory_order_relaxed);
+        }
+    }
+
+    // ensure path exists and is readable, with one probe of index if server's root is indexed
+    const char* type = NULL;
+    if (indexed)
+    {
+        pthread_rwlock_rdlock(&guard);
+        record* r = probe(path);
+        unsigned short code = (r == NULL) ? 404 : (!r->readable) ? 403 : 0;
+        if (r != NULL)
+        {
+            type = r->type;
+        }
+        pthread_rwlock_unlock(&guard);
+        if (code != 0)
+        {
+            error(c, code);
+            return;
+        }
+    }
+    else
+    {
+        // ensure path exists, caching it as missing if it doesn't
+        unsigned long before = atomic_load(&generation);
+        if (faccessat(rfd, path, F_OK, 0) == -1)
+        {
+            if (errno == ENOENT || errno == ENOTDIR)
+            {
+                mark(path, before, c->worker->now);
+            }
+            errno = 0;
+            error(c, 404);
+            return;
+        }
+
+        // ensure path is readable
+        if (faccessat(rfd, path, R_OK, 0) == -1)
+        {
+            errno = 0;
+            error(c, 403);
+            return;
+        }
+        type = lookup(extension);
+    }
+
+    // dynamic content
+    if (strcasecmp("php", extension) == 0)
+    {
+        // start script, whose output connection then waits for, rather than blocking worker's event loop
+        if (!delegate(c, path, query))
+        {
+            error(c, (backends > 0) ? 502 : 500);
+        }
+    }
+
+    // static content
+    else
+    {
+        // ensure file's MIME type is known
+        if (type == NULL)
+        {
+            error(c, 501);
+            return;
+        }
+
+        dispense(c, path, type, NULL);
+    }
+}
+
+/**
+ * Resumes parsing connection's request where it left off, rejecting the request
+ * as soon as it crosses one of Apache's limits rather than once all of it has been read.
+ * Returns length of request's headers once parsed, 0 if more octets are needed,
+ * -1 on failure (in which case an error has been queued as the response).
+ */
+ssize_t resume(connection* c)
+{
+    parser* p = &c->parser;
+    size_t i;
+    for (i = p->position; i < c->length; i++)
+    {
+        // within a token or value, skip straight to next octet that could end it
+        if (p->phase == METHOD || p->phase == TARGET || p->phase == VERSION || p->phase == NAME || p->phase == VALUE)
+        {
+            i = scan(c->request, i, c->length, p->phase == VALUE);
+            if (i == c->length)
+            {
+                break;
+            }
+        }
+
+        octet o = c->request[i];
+        switch (p->phase)
+        {
+            case METHOD:
+                if (o == ' ')
+                {
+                    p->method = (view) {p->start, i - p->start};
+                    if (p->method.length == 0)
+                    {
+                        error(c, 400);
+                        return -1;
+                    }
+                    p->start = i + 1;
+                    p->phase = TARGET;
+                }
+                else if (o == '\r' || o == '\n')
+                {
+                    // ignore empty lines before request-line
+                    if (i != p->start)
+                    {
+                        error(c, 400);
+                        return -1;
+                    }
+                    p->start = p->line = i + 1;
+                }
+                break;
+
+            case TARGET:
+                if (o == ' ')
+                {
+                    p->target = (view) {p->start, i - p->start};
+                    if (p->target.length == 0)
+                    {
+                        error(c, 400);
+                        return -1;
+                    }
+                    if (p->query.offset == 0)
+                    {
+                        p->path = p->target;
+                    }
+                    else
+                    {
+                        p->path = (view) {p->start, p->query.offset - 1 - p->start};
+                        p->query.length = i - p->query.offset;
+                    }
+                    p->start = i + 1;
+                    p->phase = VERSION;
+                }
+                else if (o == '?' && p->query.offset == 0)
+                {
+                    p->query.offset = i + 1;
+                }
+                else if (o == '\r' || o == '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                break;
+
+            case VERSION:
+                if (o == '\r')
+                {
+                    p->version = (view) {p->start, i - p->start};
+                    if (i + 2 - p->line > LimitRequestLine)
+                    {
+                        error(c, 414);
+                        return -1;
+                    }
+                    p->phase = LINE_LF;
+                }
+                else if (o == ' ' || o == '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                break;
+
+            case LINE_LF:
+            case FIELD_LF:
+                if (o != '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                p->line = i + 1;
+                p->phase = FIELD;
+                break;
+
+            case FIELD:
+                if (o == '\r')
+                {
+                    p->phase = FINAL_LF;
+                }
+
+                // fields can't be folded or nameless
+                else if (o == ' ' || o == '\t' || o == ':' || o == '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                else if (p->fields == LimitRequestFields)
+                {
+                    error(c, 431);
+                    return -1;
+                }
+                else
+                {
+                    p->start = i;
+                    p->phase = NAME;
+                }
+                break;
+
+            case NAME:
+                if (o == ':')
+                {
+                    p->names[p->fields] = (view) {p->start, i - p->start};
+                    p->start = i + 1;
+                    p->phase = VALUE;
+                }
+                else if (o == ' ' || o == '\t' || o == '\r' || o == '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                break;
+
+            case VALUE:
+                if (o == '\r')
+                {
+                    if (i - p->line > LimitRequestFieldSize)
+                    {
+                        error(c, 431);
+                        return -1;
+                    }
+
+                    // trim optional whitespace around value
+                    size_t start = p->start, end = i;
+                    while (start < end && (c->request[start] == ' ' || c->request[start] == '\t'))
+                    {
+                        start++;
+                    }
+                    while (end > start && (c->request[end - 1] == ' ' || c->request[end - 1] == '\t'))
+                    {
+                        end--;
+                    }
+                    p->values[p->fields] = (view) {start, end - start};
+                    p->fields++;
+                    p->phase = FIELD_LF;
+                }
+                else if (o == '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                break;
+
+            case FINAL_LF:
+                if (o != '\n')
+                {
+                    error(c, 400);
+                    return -1;
+                }
+                p->position = i + 1;
+                return p->position;
+        }
+    }
+    p->position = i;
+
+    // enforce limits on whatever's been received of line being parsed
+    if (p->phase <= LINE_LF && i - p->line > LimitRequestLine)
+    {
+        error(c, 414);
+        return -1;
+    }
+    if (p->phase >= NAME && p->phase <= FIELD_LF && i - p->line > LimitRequestFieldSize)
+    {
+        error(c, 431);
+        return -1;
+    }
+    return 0;
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * Runs a worker's event loop on io_uring forever, submitting everything prepared
+ * while handling one batch of completions with a single system call.
+ */
+void ring(worker* w)
+{
+    while (true)
+    {
+        // submit and wait for at least one completion, though no more than a second, so as to close idle connections
+        struct io_uring_cqe* cqe;
+        struct __kernel_timespec second = {.tv_sec = 1, .tv_nsec = 0};
+        int ret = io_uring_submit_and_wait_timeout(&w->ring, &cqe, 1, &second, NULL);
+        if (ret < 0 && ret != -ETIME && ret != -EINTR)
+        {
+            errno = -ret;
+            stop();
+        }
+        w->now = time(NULL);
+        if (w->now != w->swept)
+        {
+            // render Date header for new second
+            stamp(w);
+            expire(w);
+        }
+
+        // handle completions
+        unsigned int head, count = 0;
+        io_uring_for_each_cqe(&w->ring, head, cqe)
+        {
+            count++;
+            uint64_t data = io_uring_cqe_get_data64(cqe);
+            connection* c = (connection*) (uintptr_t) (data & ~(uint64_t) OPERATION);
+            if (c != NULL && (c->state != WAITING || c->streaming))
+            {
+                touch(c);
+            }
+            switch (data & OPERATION)
+            {
+                // connection accepted on server's socket
+                case ACCEPT:
+                    if (cqe->res >= 0)
+                    {
+                        atomic_fetch_add_explicit(&stats[self + 1].accepts, 1, memory_order_relaxed);
+                        adopt(w, cqe->res);
+                    }
+                    if (!(cqe->flags & IORING_CQE_F_MORE))
+                    {
+                        struct io_uring_sqe* sqe = submission(w);
+                        io_uring_prep_multishot_accept(sqe, sfd, NULL, NULL, SOCK_CLOEXEC);
+                        io_uring_sqe_set_data64(sqe, ACCEPT);
+                    }
+                    break;
+
+                // connections handed over by main thread
+                case WAKE:
+                {
+                    int cfd;
+                    while (dequeue(&cfd))
+                    {
+                        adopt(w, cfd);
+                    }
+                    struct io_uring_sqe* sqe = submission(w);
+                    io_uring_prep_read(sqe, w->wfd, &w->wakeups, sizeof(w->wakeups), 0);
+                    io_uring_sqe_set_data64(sqe, WAKE);
+                    break;
+                }
+
+                // octets received from client
+                case RECV:
+                    if (!(cqe->flags & IORING_CQE_F_MORE))
+                    {
+                        c->armed = false;
+                        c->inflight--;
+                    }
+                    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+                    {
+                        unsigned short id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                        octet* buffer = w->pool + id * BUFFER;
+
+                        // keep octets for proceed to parse, once no response is on its way; if they don't fit
+                        // in a request's headers, reject request, unless a response is on its way (and so
+                        // mustn't be touched), in which case just close connection
+                        if (!receive(c, buffer, cqe->res))
+                        {
+                            if (c->state == READING && c->inflight == (c->armed ? 1 : 0))
+                            {
+                                error(c, 413);
+                                c->state = WRITING;
+                            }
+                            else
+                            {
+                                c->state = CLOSING;
+                            }
+                        }
+
+                        // give buffer back to ring
+                        io_uring_buf_ring_add(w->buffers, buffer, BUFFER, id, io_uring_buf_ring_mask(BUFFERS), 0);
+                        io_uring_buf_ring_advance(w->buffers, 1);
+                    }
+
+                    // client closed connection, or recv failed other than for want of buffers,
+                    // so send whatever responses remain, then close connection (though, while a script runs,
+                    // only once its output's been relayed, since client may just have shut down its sending half,
+                    // whereupon proceed finds as much when it receives again)
+                    else if (cqe->res != -ENOBUFS && c->state == READING)
+                    {
+                        c->state = (c->first < c->parts) ? WRITING : CLOSING;
+                    }
+                    proceed(c);
+                    break;
+
+                // octets sent to client
+                case SEND:
+                    c->inflight--;
+                    if (cqe->res < 0)
+                    {
+                        c->state = CLOSING;
+                    }
+                    else
+                    {
+                        advance(c, cqe->res);
+                    }
+                    proceed(c);
+                    break;
+
+                // octets read from file, none if file shrank since its length was announced (or read failed),
+                // whereupon response is cut short, though what was read is still sent before closing connection
+                // (unless they can't be appended to response, whereupon connection's closed at once)
+                case READ:
+                    c->inflight--;
+                    if (cqe->res <= 0)
+                    {
+                        c->pending = 0;
+                        c->persistent = false;
+                    }
+                    else if (!attach(c, NULL, c->size, cqe->res))
+                    {
+                        c->state = CLOSING;
+                    }
+                    else
+                    {
+                        c->size += cqe->res;
+                        c->pending -= cqe->res;
+                        c->offset += cqe->res;
+                    }
+                    proceed(c);
+                    break;
+
+                // octets of script's output read from its gateway
+                case RELAY:
+                    c->inflight--;
+                    if (c->state == WAITING)
+                    {
+                        if (cqe->res > 0)
+                        {
+                            if (absorb(c, cqe->res))
+                            {
+                                conclude(c, true);
+                            }
+                            else if (!stream(c))
+                            {
+                                conclude(c, false);
+                            }
+                        }
+                        else
+                        {
+                            // php-cgi's output ends when it exits, but a backend's only with FCGI_END_REQUEST
+                            conclude(c, cqe->res == 0 && c->backend == NULL);
+                        }
+                    }
+                    proceed(c);
+                    break;
+            }
+        }
+        io_uring_cq_advance(&w->ring, count);
+        bury(w);
+    }
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * Returns offset of first CR or LF (or, unless lines, SP, HT, "?" or ":") in buffer
+ * from offset from up to offset to, else to, 32 octets at a time.
+ */
+__attribute__((target("avx2")))
+size_t scan_avx2(const octet* buffer, size_t from, size_t to, bool lines)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i ht = _mm256_set1_epi8('\t');
+    const __m256i question = _mm256_set1_epi8('?');
+    const __m256i colon = _mm256_set1_epi8(':');
+    while (from + 32 <= to)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i*) (buffer + from));
+        __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf));
+        if (!lines)
+        {
+            found = _mm256_or_si256(found, _mm256_or_si256(_mm256_cmpeq_epi8(block, sp), _mm256_cmpeq_epi8(block, ht)));
+            found = _mm256_or_si256(found, _mm256_or_si256(_mm256_cmpeq_epi8(block, question), _mm256_cmpeq_epi8(block, colon)));
+        }
+        unsigned int mask = _mm256_movemask_epi8(found);
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 32;
+    }
+    return scan_scalar(buffer, from, to, lines);
+}
+#endif
+
+/**
+ * Returns offset of first CR or LF (or, unless lines, SP, HT, "?" or ":") in buffer
+ * from offset from up to offset to, else to, one octet at a time.
+ */
+size_t scan_scalar(const octet* buffer, size_t from, size_t to, bool lines)
+{
+    for (; from < to; from++)
+    {
+        octet o = buffer[from];
+        if (o == '\r' || o == '\n')
+        {
+            break;
+        }
+        if (!lines && (o == ' ' || o == '\t' || o == '?' || o == ':'))
+        {
+            break;
+        }
+    }
+    return from;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * Returns offset of first CR or LF (or, unless lines, SP, HT, "?" or ":") in buffer
+ * from offset from up to offset to, else to, 16 octets at a time.
+ */
+__attribute__((target("sse4.2")))
+size_t scan_sse42(const octet* buffer, size_t from, size_t to, bool lines)
+{
+    const __m128i delimiters = _mm_setr_epi8('\r', '\n', ' ', '\t', '?', ':', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    int n = lines ? 2 : 6;
+    while (from + 16 <= to)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*) (buffer + from));
+        int index = _mm_cmpestri(delimiters, n, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index < 16)
+        {
+            return from + index;
+        }
+        from += 16;
+    }
+    return scan_scalar(buffer, from, to, lines);
+}
+#endif
+
+/**
+ * Finds program on PATH (or at program itself, if it's a path) as execvp would, returning its path, to be freed,
+ * else NULL.
+ */
+char* search(const char* program)
+{
+    if (strchr(program, '/') != NULL)
+    {
+        return (access(program, X_OK) == 0) ? strdup(program) : NULL;
+    }
+    const char* path = getenv("PATH");
+    if (path == NULL)
+    {
+        path = "/usr/local/bin:/usr/bin:/bin";
+    }
+    while (true)
+    {
+        // try each of PATH's directories in turn, an empty one meaning current directory
+        const char* colon = strchrnul(path, ':');
+        int length = colon - path;
+        char candidate[length + strlen(program) + 3];
+        sprintf(candidate, "%.*s/%s", (length == 0) ? 1 : length, (length == 0) ? "." : path, program);
+        struct stat info;
+        if (access(candidate, X_OK) == 0 && stat(candidate, &info) == 0 && S_ISREG(info.st_mode))
+        {
+            errno = 0;
+            return strdup(candidate);
+        }
+        if (*colon == '\0')
+        {
+            errno = 0;
+            return NULL;
+        }
+        path = colon + 1;
+    }
+}
+
+/**
+ * Advances connection through its states for as far as its socket allows,
+ * answering pipelined requests back to back and writing their responses together.
+ */
+void serve(connection* c)
+{
+    while (true)
+    {
+        // relay script's output as it arrives, writing response (and any batched before it) meanwhile, reading
+        // no more output while enough of it awaits writing
+        if (c->state == WAITING)
+        {
+            if (!c->drained)
+            {
+                relay(c);
+                if (c->state != WAITING)
+                {
                     continue;
                 }
-                
-                // load file
-                ssize_t size = load();
-                if (size == -1)
+            }
+            int written = flush(c);
+            if (written == -1)
+            {
+                reset(c);
+                return;
+            }
+            if (written == 1 && !c->drained && c->gfd != -1)
+            {
+                continue;
+            }
+            return;
+        }
+
+        // read request's headers, unless enough responses already await writing
+        if (c->state == READING)
+        {
+            bool full = batched(c);
+            ssize_t octets = full ? 0 : parse(c);
+            if (octets > 0)
+            {
+                c->state = RESPONDING;
+            }
+            else if (octets < 0)
+            {
+                // send whatever error parse queued, if any, after responses batched before it
+                c->state = WRITING;
+            }
+            else
+            {
+                // no whole request remains, so write responses batched so far, then wait for more octets
+                int written = flush(c);
+                if (written == -1)
+                {
+                    c->state = CLOSING;
+                }
+                else if (written == 1 && full)
                 {
-                    error(500);
                     continue;
                 }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        // build response, then move on to next request, if client and server are willing,
+        // unless a file's to be sent after it
+        if (c->state == RESPONDING)
+        {
+            respond(c);
+            if (c->state == WAITING)
+            {
+                continue;
+            }
+            if (c->persistent && c->pending == 0)
+            {
+                recycle(c);
+                continue;
+            }
+            c->state = WRITING;
+        }
+
+        // write responses, along with any file
+        if (c->state == WRITING)
+        {
+            int written = flush(c);
+            if (written == 0)
+            {
+                // wait for socket to become writable
+                return;
+            }
+
+            // move on to next request, if client and server are willing, else close connection, once client's
+            // done sending, if response was written
+            if (written == 1 && c->persistent)
+            {
+                recycle(c);
+                continue;
+            }
+            if (written == 1)
+            {
+                linger(c);
+            }
+            else
+            {
+                c->state = CLOSING;
+            }
+        }
+
+        // discard what client still sends, a batch's worth per event, until it closes its end
+        if (c->state == LINGERING)
+        {
+            octet sink[OCTETS * 8];
+            ssize_t octets = 0;
+            for (size_t discarded = 0; discarded < BATCH; discarded += octets)
+            {
+                octets = read(c->cfd, sink, sizeof(sink));
+                if (octets <= 0)
+                {
+                    break;
+                }
+            }
+            if (octets > 0 || (octets == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+            {
+                errno = 0;
+                return;
+            }
+            errno = 0;
+            c->state = CLOSING;
+        }
+
+        // close connection
+        if (c->state == CLOSING)
+        {
+            reset(c);
+            return;
+        }
+    }
+}
+
+/**
+ * Ends any chunk of script's output spliced to client, then, if php-cgi's pipe holds enough output to be worth
+ * splicing (and response needs no more of it than framing), starts a chunk of all of it, which flush splices
+ * to client after chunk's header. Returns false on failure.
+ */
+bool siphon(connection* c)
+{
+    if (c->owing)
+    {
+        if (!append(c, "\r\n", 2))
+        {
+            return false;
+        }
+        c->owing = false;
+    }
+
+    // a backend's output is framed in FastCGI's records, and gzipped output must pass through zlib
+    if (c->backend != NULL || !c->streaming || !c->chunked)
+    {
+        return true;
+    }
+#ifdef HAVE_ZLIB
+    if (c->deflating != NULL)
+    {
+        return true;
+    }
+#endif
+    int available;
+    if (ioctl(c->gfd, FIONREAD, &available) == -1 || available < SPLICEABLE)
+    {
+        errno = 0;
+        return true;
+    }
+    if (!format(c, "%x\r\n", available))
+    {
+        return false;
+    }
+    c->spliced = available;
+    c->owing = true;
+    return true;
+}
+
+/**
+ * Forks worker process i, which binds its own socket to server's port.
+ * Returns true in worker process, false in master process.
+ */
+bool spawn(int i)
+{
+    // don't let worker inherit unflushed output
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        stop();
+    }
+
+    // master process
+    if (pid > 0)
+    {
+        pids[i] = pid;
+        return false;
+    }
+
+    // worker process, which dies along with master
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    self = i;
+    free(pids);
+    pids = NULL;
+
+    // let master alone report
+    signal(SIGUSR1, SIG_IGN);
+
+    // optionally pin worker to a core
+    if (pinned)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(i % sysconf(_SC_NPROCESSORS_ONLN), &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        {
+            errno = 0;
+        }
+    }
+
+    // replace master's socket with worker's own
+    close(sfd);
+    sfd = listener(listening, true);
+    return true;
+}
+
+/**
+ * Renders worker's Date header for current time.
+ */
+void stamp(worker* w)
+{
+    struct tm tm;
+    gmtime_r(&w->now, &tm);
+    w->datelen = strftime(w->date, sizeof(w->date), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+}
+
+/**
+ * Determines which ranges of a file of size octets client requested, per request's Range (unless its If-Range names
+ * another version of file than the one whose validators are given). Returns number of satisfiable ranges,
+ * 0 if file is to be sent whole instead, or -1 if no range is satisfiable.
+ * http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.35
+ */
+int span(connection* c, size_t size, const char* validators, size_t length, time_t modified, range* ranges)
+{
+    view value;
+    if (!field(c, "Range", &value))
+    {
+        return 0;
+    }
+
+    // ignore Range unless If-Range, if any, names this version of file, by (strong) entity-tag or by date
+    view condition;
+    if (field(c, "If-Range", &condition))
+    {
+        const octet* v = c->request + condition.offset;
+        if (condition.length > 0 && (v[0] == '"' || v[0] == 'W'))
+        {
+            const char* tag = validators + strlen("ETag: ");
+            const char* end = memchr(tag, '\r', length - strlen("ETag: "));
+            if (condition.length != (size_t) (end - tag) || memcmp(v, tag, end - tag) != 0)
+            {
+                return 0;
+            }
+        }
+        else if (timestamp(c, condition) != modified)
+        {
+            return 0;
+        }
+    }
+
+    // ignore Range unless it's a list of byte-range-specs
+    const octet* item = c->request + value.offset;
+    const octet* stop = item + value.length;
+    if (value.length < 6 || strncasecmp(item, "bytes=", 6) != 0)
+    {
+        return 0;
+    }
+    item += 6;
+    int count = 0;
+    bool specified = false;
+    size_t total = 0;
+    while (item < stop)
+    {
+        // find spec's end, trimming whitespace around it
+        const octet* comma = memchr(item, ',', stop - item);
+        const octet* next = (comma != NULL) ? comma + 1 : stop;
+        const octet* last = (comma != NULL) ? comma : stop;
+        while (item < last && (*item == ' ' || *item == '\t'))
+        {
+            item++;
+        }
+        while (last > item && (last[-1] == ' ' || last[-1] == '\t'))
+        {
+            last--;
+        }
+
+        // skip empty elements of list
+        if (item == last)
+        {
+            item = next;
+            continue;
+        }
+
+        // parse first-byte-pos "-" [last-byte-pos], or "-" suffix-length, saturating rather than overflowing
+        size_t numbers[2] = {0, 0};
+        bool present[2] = {false, false};
+        int which = 0;
+        for (const octet* p = item; p < last; p++)
+        {
+            if (*p == '-' && which == 0)
+            {
+                which = 1;
+            }
+            else if (*p >= '0' && *p <= '9')
+            {
+                numbers[which] = (numbers[which] > (SIZE_MAX - 9) / 10) ? SIZE_MAX : numbers[which] * 10 + (*p - '0');
+                present[which] = true;
+            }
+            else
+            {
+                return 0;
+            }
+        }
+        item = next;
+        if (which == 0 || (!present[0] && !present[1]) || (present[0] && present[1] && numbers[1] < numbers[0]))
+        {
+            return 0;
+        }
+        specified = true;
+
+        // resolve spec against file's size, skipping it if unsatisfiable
+        range r;
+        if (!present[0])
+        {
+            if (numbers[1] == 0 || size == 0)
+            {
+                continue;
+            }
+            r.first = (numbers[1] < size) ? size - numbers[1] : 0;
+            r.last = size - 1;
+        }
+        else
+        {
+            if (numbers[0] >= size)
+            {
+                continue;
+            }
+            r.first = numbers[0];
+            r.last = (present[1] && numbers[1] < size) ? numbers[1] : size - 1;
+        }
+
+        // too many ranges to bother with, so send file whole
+        if (count == RANGES)
+        {
+            return 0;
+        }
+        ranges[count++] = r;
+        total += r.last - r.first + 1;
+    }
+    if (!specified)
+    {
+        return 0;
+    }
+    if (count == 0)
+    {
+        return -1;
+    }
+
+    // rather than copy too much of file into a multipart response, send file whole
+    if (count > 1 && total > EXCERPTS)
+    {
+        return 0;
+    }
+    return count;
+}
+
+/**
+ * Starts server.
+ */
+void start(short port, const char* path)
+{
+    // count connections accepted and files cached, in memory shared with any worker processes
+    stats = mmap(NULL, (processes + 1) * sizeof(counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED)
+    {
+        stats = NULL;
+        stop();
+    }
+
+    // pre-render responses' Status-Lines, and errors
+    render();
+
+    // map extensions to MIME types
+    if (!tabulate(mimetypes))
+    {
+        stop();
+    }
+
+    // pick fastest way to scan requests that this CPU supports
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        scan = scan_avx2;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        scan = scan_sse42;
+    }
+#endif
+
+    // path to server's root
+    root = realpath(path, NULL);
+    if (root == NULL)
+    {
+        stop();
+    }
+
+    // ensure root exists
+    if (access(root, F_OK) == -1)
+    {
+        stop();
+    }
+
+    // ensure root is executable
+    if (access(root, X_OK) == -1)
+    {
+        stop();
+    }
+
+    // open root, relative to which requested paths are resolved
+    rfd = open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (rfd == -1)
+    {
+        stop();
+    }
+
+    // announce root
+    printf("\033[33m"); // tells bash to change the text color to brown
+    printf("Using %s for server's root", root);
+    printf("\033[39m\n"); // tells bash to stop coloring
+
+    // without worker processes, listen right away
+    if (processes == 0)
+    {
+        sfd = listener(port, true);
+    }
+
+    // otherwise reserve the port for worker processes, but leave listening to them,
+    // lest this process's socket take a share of connections that it would never accept
+    else
+    {
+        sfd = listener(port, false);
+    }
+
+    // announce port in use
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(sfd, (struct sockaddr*) &addr, &addrlen) == -1)
+    {
+        stop();
+    }
+    listening = ntohs(addr.sin_port);
+    printf("\033[33m");
+    printf("Listening on port %i", listening);
+    printf("\033[39m\n");
+}
+
+/**
+ * Stop server, deallocating any resources.
+ */
+void stop(void)
+{
+    // preserve errno across this function's library calls
+    int errsv = errno;
+
+    // stop worker processes, if master
+    if (pids != NULL)
+    {
+        for (int i = 0; i < processes; i++)
+        {
+            if (pids[i] > 0)
+            {
+                kill(pids[i], SIGTERM);
+            }
+        }
+        while (wait(NULL) > 0);
+        free(pids);
+    }
+
+    // stop FastCGI backends, if any
+    for (int i = 0; workers != NULL && i < ((threads == 0) ? 1 : threads); i++)
+    {
+        for (int j = 0; workers[i].interpreters != NULL && j < backends; j++)
+        {
+            if (workers[i].interpreters[j].pid > 0)
+            {
+                kill(workers[i].interpreters[j].pid, SIGKILL);
+            }
+        }
+    }
+
+    // close every open connection (letting go of backends already stopped), unless worker threads
+    // (which exit along with process) own them
+    if (threads == 0 && workers != NULL)
+    {
+        while (workers[0].connections != NULL)
+        {
+            workers[0].connections->backend = NULL;
+            reset(workers[0].connections);
+        }
+        bury(&workers[0]);
+        free(workers[0].exiting);
+    }
 
-                // subtract php-cgi's headers from body's size to get content's length
-                haystack = body; 
-                
-                needle = memmem(haystack, size, "\r\n\r\n", 4);
-                if (needle == NULL)
-                {
-                    error(500);
-                    continue;
-                }
-                size_t length = size - (needle - haystack + 4);
+    // free root, which was allocated by realpath
+    if (root != NULL)
+    {
+        free(root);
+    }
 
-                // respond to client
-                if (dprintf(cfd, "HTTP/1.1 200 OK\r\n") < 0)
-                {
-                    continue;
-                }
-                if (dprintf(cfd, "Connection: close\r\n") < 0)
+    // free php-cgi's path
+    if (interpreter != NULL)
+    {
+        free(interpreter);
+    }
+
+    // close root
+    if (rfd != -1)
+    {
+        close(rfd);
+    }
+
+    // close workers' epoll instances and eventfds
+    if (workers != NULL)
+    {
+        for (int i = 0, n = (threads == 0) ? 1 : threads; i < n; i++)
+        {
+            if (workers[i].efd > 0)
+            {
+                close(workers[i].efd);
+            }
+            if (workers[i].wfd > 0)
+            {
+                close(workers[i].wfd);
+            }
+        }
+    }
+
+    // close server socket
+    if (sfd != -1)
+    {
+        close(sfd);
+    }
+
+    // close inotify instance
+    if (nfd != -1)
+    {
+        close(nfd);
+    }
+
+    // terminate process
+    if (errsv == 0)
+    {
+        // success
+        exit(0);
+    }
+    else
+    {
+        // announce error
+        printf("\033[33m");
+        printf("%s", strerror(errsv));
+        printf("\033[39m\n");
+
+        // failure
+        exit(1);
+    }
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * Returns a free submission queue entry, submitting queued ones if none is free.
+ */
+struct io_uring_sqe* submission(worker* w)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&w->ring);
+    while (sqe == NULL)
+    {
+        io_uring_submit(&w->ring);
+        sqe = io_uring_get_sqe(&w->ring);
+    }
+    return sqe;
+}
+#endif
+
+/**
+ * Turns script's output loaded into body so far into connection's response: once script's CGI headers have all
+ * arrived, into response's headers, then whatever content follows them into chunks (gzipped, if so chosen),
+ * emptying body. Returns false if headers are malformed (or too long), or on failure.
+ */
+bool stream(connection* c)
+{
+    size_t headers = 0;
+    if (!c->streaming)
+    {
+        // find blank line after headers, each line of which may end with LF alone
+        for (octet* lf = memchr(c->body, '\n', c->loaded); lf != NULL; lf = memchr(lf + 1, '\n', c->body + c->loaded - lf - 1))
+        {
+            size_t i = lf - c->body + 1;
+            if (i < c->loaded && c->body[i] == '\n')
+            {
+                headers = i + 1;
+                break;
+            }
+            if (i + 1 < c->loaded && c->body[i] == '\r' && c->body[i + 1] == '\n')
+            {
+                headers = i + 2;
+                break;
+            }
+        }
+        if (headers == 0)
+        {
+            return c->loaded <= PREAMBLE;
+        }
+        if (!translate(c, headers))
+        {
+            return false;
+        }
+        c->streaming = true;
+    }
+
+    bool streamed = true;
+    if (c->loaded > headers)
+    {
+#ifdef HAVE_ZLIB
+        if (c->deflating != NULL)
+        {
+            streamed = squeeze(c, c->body + headers, c->loaded - headers, false);
+        }
+        else
+#endif
+        streamed = chunk(c, c->body + headers, c->loaded - headers);
+    }
+    c->loaded = 0;
+    return streamed;
+}
+
+/**
+ * Starts (or restarts) php-cgi as backend, handing it backend's socket as its stdin, whereupon it speaks FastCGI
+ * (as though it had bound the socket itself with -b), and reaping any php-cgi it replaces.
+ */
+void summon(backend* b)
+{
+    // kill php-cgi outright, since it only takes note of SIGTERM between scripts
+    if (b->pid > 0)
+    {
+        kill(b->pid, SIGKILL);
+        waitpid(b->pid, NULL, 0);
+    }
+
+    // only async-signal-safe calls between fork and exec, lest another thread hold a lock (hence php-cgi's path
+    // having been found beforehand, and environment being passed explicitly)
+    char* argv[] = {"php-cgi", NULL};
+    b->pid = fork();
+    if (b->pid == 0)
+    {
+        // die along with server, with signals that worker threads block (or server ignores) restored
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        sigset_t set;
+        sigemptyset(&set);
+        sigprocmask(SIG_SETMASK, &set, NULL);
+        signal(SIGPIPE, SIG_DFL);
+        if (dup2(b->lfd, STDIN_FILENO) == -1)
+        {
+            _exit(127);
+        }
+        execve(interpreter, argv, environ);
+        _exit(127);
+    }
+    errno = 0;
+}
+
+/**
+ * Forks worker processes, then restarts any that die, forever.
+ * Returns only in worker processes.
+ */
+void supervise(void)
+{
+    pids = calloc(processes, sizeof(pid_t));
+    if (pids == NULL)
+    {
+        stop();
+    }
+    time_t started[processes];
+
+    // fork workers
+    for (int i = 0; i < processes; i++)
+    {
+        started[i] = time(NULL);
+        if (spawn(i))
+        {
+            return;
+        }
+    }
+
+    // reap workers
+    while (true)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1)
+        {
+            if (errno == EINTR)
+            {
+                errno = 0;
+                continue;
+            }
+            stop();
+        }
+
+        // determine which worker died
+        int i = 0;
+        while (i < processes && pids[i] != pid)
+        {
+            i++;
+        }
+        if (i == processes)
+        {
+            continue;
+        }
+
+        // announce death
+        printf("\033[31m");
+        if (WIFSIGNALED(status))
+        {
+            printf("Worker %i (pid %i) killed by signal %i", i, pid, WTERMSIG(status));
+        }
+        else
+        {
+            printf("Worker %i (pid %i) exited with status %i", i, pid, WEXITSTATUS(status));
+        }
+        printf("\033[39m\n");
+
+        // restart worker, though not in a tight loop if it keeps dying right away
+        pids[i] = 0;
+        if (time(NULL) - started[i] < 1)
+        {
+            sleep(1);
+        }
+        started[i] = time(NULL);
+        if (spawn(i))
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Watches a directory within server's root (as visited by nftw) for changes to its files (or notes that it can't),
+ * and indexes each file within it if server's root is indexed.
+ */
+int survey(const char* path, const struct stat* info, int flag, struct FTW* ftw __attribute__((unused)))
+{
+    // path relative to server's root
+    const char* relative = path + strlen(root);
+    while (*relative == '/')
+    {
+        relative++;
+    }
+
+    // index regular files, and symbolic links to them
+    if (flag == FTW_F || flag == FTW_SL)
+    {
+        if (indexed && flag == FTW_F && S_ISREG(info->st_mode))
+        {
+            catalog(relative, info);
+        }
+        else if (indexed && flag == FTW_SL)
+        {
+            refresh(relative);
+        }
+        return 0;
+    }
+    if (flag != FTW_D || nfd == -1)
+    {
+        return 0;
+    }
+    int wd = inotify_add_watch(nfd, path, IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+
+    // files within a directory that can't be watched (e.g., once fs.inotify.max_user_watches is reached)
+    // would go stale in cache, so don't cache them
+    if (wd == -1)
+    {
+        printf("\033[31m");
+        printf("Not caching files in %s, which can't be watched: %s", path, strerror(errno));
+        printf("\033[39m\n");
+        errno = 0;
+        neglect(relative, true);
+        return 0;
+    }
+    neglect(relative, false);
+
+    // remember directory's path relative to server's root, by watch descriptor
+    if (wd >= watches)
+    {
+        char** grown = realloc(watched, (wd + 1) * sizeof(char*));
+        if (grown == NULL)
+        {
+            return 0;
+        }
+        memset(grown + watches, 0, (wd + 1 - watches) * sizeof(char*));
+        watched = grown;
+        watches = wd + 1;
+    }
+    free(watched[wd]);
+    watched[wd] = strdup(relative);
+    return 0;
+}
+
+/**
+ * Caches entry as most recently used, evicting least recently used entries to make room, but only if its file
+ * can't have changed since generation was before, and only if another thread hasn't cached it meanwhile
+ * (else frees entry once no response refers to it). Cache's lock must be held.
+ */
+void store(entry* e, unsigned long before)
+{
+    if (atomic_load(&generation) != before || locate(e->path, e->encoding) != NULL)
+    {
+        e->forgotten = true;
+        if (e->references == 0)
+        {
+            discard(e);
+        }
+        return;
+    }
+
+    // evict least recently used entries until there's room
+    while (cached + e->length > budget && oldest != NULL)
+    {
+        forget(oldest);
+        atomic_fetch_add_explicit(&stats[self + 1].evictions, 1, memory_order_relaxed);
+    }
+
+    // insert as most recently used
+    entry** bucket = &buckets[hash(e->path) & (BUCKETS - 1)];
+    e->chain = *bucket;
+    *bucket = e;
+    e->prev = newest;
+    if (newest != NULL)
+    {
+        newest->next = e;
+    }
+    else
+    {
+        oldest = e;
+    }
+    newest = e;
+    cached += e->length;
+}
+
+/**
+ * Builds perfect hash table of MIME types by extension from those built in, plus those in mime.types-formatted
+ * file at path (each line a type followed by its extensions), if not NULL, whose mappings take precedence.
+ * Returns false if file can't be read or table can't be built.
+ */
+bool tabulate(const char* path)
+{
+    // gather mappings, built in first
+    size_t n = sizeof(builtins) / sizeof(builtins[0]);
+    size_t capacity = n;
+    mapping* list = malloc(capacity * sizeof(mapping));
+    if (list == NULL)
+    {
+        return false;
+    }
+    memcpy(list, builtins, sizeof(builtins));
+    if (path != NULL)
+    {
+        FILE* file = fopen(path, "r");
+        if (file == NULL)
+        {
+            free(list);
+            return false;
+        }
+        char* line = NULL;
+        size_t size = 0;
+        bool failed = false;
+        while (!failed && getline(&line, &size, file) != -1)
+        {
+            char* state;
+            char* token = strtok_r(line, " \t\r\n", &state);
+            if (token == NULL || token[0] == '#')
+            {
+                continue;
+            }
+            char* type = NULL;
+            bool used = false;
+            for (char* extension = strtok_r(NULL, " \t\r\n", &state); extension != NULL && extension[0] != '#';
+                extension = strtok_r(NULL, " \t\r\n", &state))
+            {
+                // type and extensions are kept for as long as server runs
+                if (type == NULL)
                 {
-                    continue;
+                    type = strdup(token);
                 }
-                if (dprintf(cfd, "Content-Length: %i\r\n", length) < 0)
+                if (type != NULL && n == capacity)
                 {
-                    continue;
+                    mapping* bigger = realloc(list, capacity * 2 * sizeof(mapping));
+                    if (bigger != NULL)
+                    {
+                        list = bigger;
+                        capacity *= 2;
+                    }
                 }
-                if (write(cfd, body, size) == -1)
+                char* copy = (type != NULL && n < capacity) ? strdup(extension) : NULL;
+                if (copy == NULL)
                 {
-                    continue;
+                    failed = true;
+                    break;
                 }
+                list[n].extension = copy;
+                list[n].type = type;
+                used = true;
+                n++;
             }
 
-            // static content
-            else
+            // type is line's own until a mapping refers to it
+            if (!used)
             {
-                // look up file's MIME type
-                const char* type = lookup(extension);
+                free(type);
+            }
+        }
+        free(line);
+        fclose(file);
 
-                if (type == NULL)
+        // let go of file's mappings if they couldn't all be kept (those of a type being consecutive)
+        if (failed)
+        {
+            for (size_t i = sizeof(builtins) / sizeof(builtins[0]); i < n; i++)
+            {
+                free((char*) list[i].extension);
+                if (i + 1 == n || list[i + 1].type != list[i].type)
                 {
-                    error(501);
-                    continue;
+                    free((char*) list[i].type);
                 }
+            }
+            free(list);
+            return false;
+        }
+        errno = 0;
+    }
 
-                // open file
-                file = fopen(path, "r"); // here is where the magic happens. Opens the file in the server.
-                if (file == NULL)
+    // until every extension has a slot of its own, try ever more slots, at most half of them used,
+    // and groups of about 2 extensions each
+    for (spread = 2; spread < 2 * n; spread *= 2);
+    for (groups = 1; 2 * groups < n; groups *= 2);
+    size_t* heads = malloc(groups * sizeof(size_t));
+    size_t* chain = malloc(n * sizeof(size_t));
+    size_t* sizes = calloc(groups, sizeof(size_t));
+    bool* kept = calloc(n, sizeof(bool));
+    displacements = calloc(groups, sizeof(uint32_t));
+    mappings = NULL;
+    bool built = (heads != NULL && chain != NULL && sizes != NULL && kept != NULL && displacements != NULL);
+    if (built)
+    {
+        // group extensions by hash, keeping only the last mapping of any extension mapped more than once
+        // (which hashes into the same group)
+        size_t largest = 0;
+        memset(heads, 0xff, groups * sizeof(size_t));
+        for (size_t i = n; i-- > 0;)
+        {
+            size_t g = fold(list[i].extension, 0) & (groups - 1);
+            size_t j = heads[g];
+            while (j != SIZE_MAX && strcasecmp(list[j].extension, list[i].extension) != 0)
+            {
+                j = chain[j];
+            }
+            if (j == SIZE_MAX)
+            {
+                kept[i] = true;
+                chain[i] = heads[g];
+                heads[g] = i;
+                if (++sizes[g] > largest)
                 {
-                    error(500);
-                    continue;
-                }
-                
-                // load file
-                ssize_t length = load(); // after this function the variable body contains all the file
-                if (length == -1)        
-                {                         
-                    error(500);
-                    continue;
+                    largest = sizes[g];
                 }
+            }
+        }
 
-                // TODO: respond to client
-                                           
-                                           
-                // respond to client
-                if (dprintf(cfd, "HTTP/1.1 200 OK\r\n") < 0) 
-                {
-                    continue;
-                }
-                if (dprintf(cfd, "Connection: close\r\n") < 0)
-                {
-                    continue;
-                }
-                if (dprintf(cfd, "Content-Length: %i\r\n", length) < 0)
-                {
-                    continue;
-                }
-                if (dprintf(cfd, "Content-Type: %s\r\n\r\n", type) < 0)
+        while (true)
+        {
+            mappings = calloc(spread, sizeof(mapping));
+            if (mappings == NULL)
+            {
+                built = false;
+                break;
+            }
+
+            // place largest groups first, while slots are plentiful, finding a displacement for each
+            // that takes its extensions to distinct, free slots
+            bool placed = true;
+            for (size_t size = largest; size > 0 && placed; size--)
+            {
+                for (size_t g = 0; g < groups && placed; g++)
                 {
-                    continue;
+                    if (sizes[g] != size)
+                    {
+                        continue;
+                    }
+                    placed = false;
+                    for (uint32_t d = 0; d < 65536 && !placed; d++)
+                    {
+                        size_t j;
+                        for (j = heads[g]; j != SIZE_MAX; j = chain[j])
+                        {
+                            mapping* m = &mappings[fold(list[j].extension, d + 1) & (spread - 1)];
+                            if (m->extension != NULL)
+                            {
+                                break;
+                            }
+                            *m = list[j];
+                        }
+
+                        // undo a displacement that collides
+                        if (j != SIZE_MAX)
+                        {
+                            for (size_t k = heads[g]; k != j; k = chain[k])
+                            {
+                                mappings[fold(list[k].extension, d + 1) & (spread - 1)].extension = NULL;
+                            }
+                            continue;
+                        }
+                        displacements[g] = d;
+                        placed = true;
+                    }
                 }
-                if (write(cfd, body, length) == -1)
+            }
+            if (placed)
+            {
+                break;
+            }
+            free(mappings);
+            spread *= 2;
+        }
+
+        // free strings that only overridden mappings (from file) refer to
+        for (size_t i = sizeof(builtins) / sizeof(builtins[0]), j; i < n; i = j)
+        {
+            bool used = false;
+            for (j = i; j < n && list[j].type == list[i].type; j++)
+            {
+                used = used || kept[j];
+                if (!kept[j])
                 {
-                    continue;
+                    free((char*) list[j].extension);
                 }
             }
-            
-            // announce OK
-            printf("\033[32m");
-            printf("HTTP/1.1 200 OK");
-            printf("\033[39m\n");
+            if (!used)
+            {
+                free((char*) list[i].type);
+            }
         }
     }
+    free(heads);
+    free(chain);
+    free(sizes);
+    free(kept);
+    free(list);
+    return built;
 }
 
 /**
- * Accepts a connection from a client, blocking (i.e., waiting) until one is heard.
- * Upon success, returns true; upon failure, returns false.
+ * Renders file's validators into buffer as headers: an ETag, from file's inode, size and time of last modification
+ * (to the microsecond), plus its encoding, if any, and a Last-Modified, followed by file's Content-Encoding,
+ * if any, and by a Vary if file's response varies with Accept-Encoding. Returns their length.
  */
-bool connected(void)
-{   
-    // sockaddr is a structure that contains the the address family (http) and the socket address.
-    struct sockaddr_in cli_addr; // declare ONE struct socket address (contains family and IP)
-    memset(&cli_addr, 0, sizeof(cli_addr)); // fills the first sizeof(cli_addr) bytes with 0 (zeroes) to &cli_addr. IOW it initializes it to 0. 
-    socklen_t cli_len = sizeof(cli_addr); // socklen_t is an unsigned 32 bites int. cli_len is the size of the client address
-     
-     cfd = accept(sfd, (struct sockaddr*) &cli_addr, &cli_len);
-
-     
-    
-    if (cfd == -1)
+int tag(char* buffer, size_t size, const struct stat* info, const char* encoding, bool vary)
+{
+    struct tm tm;
+    gmtime_r(&info->st_mtime, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    unsigned long long modified = (unsigned long long) info->st_mtim.tv_sec * 1000000 + info->st_mtim.tv_nsec / 1000;
+    int length = snprintf(buffer, size, "ETag: \"%lx-%llx-%llx%s%s\"\r\nLast-Modified: %s\r\n", (unsigned long) info->st_ino,
+        (unsigned long long) info->st_size, modified, (encoding != NULL) ? "-" : "", (encoding != NULL) ? encoding : "", date);
+    if (encoding != NULL)
     {
-        return false;
+        length += snprintf(buffer + length, size - length, "Content-Encoding: %s\r\n", encoding);
     }
-    return true;
+    if (vary)
+    {
+        length += snprintf(buffer + length, size - length, "Vary: Accept-Encoding\r\n");
+    }
+    return length;
 }
 
 /**
- * Handles client errors (4xx) and server errors (5xx).
+ * Parses a header's value as an HTTP-date (in RFC 1123's format). Returns -1 if it isn't one.
+ * http://www.w3.org/Protocols/rfc2616/rfc2616-sec3.html#sec3.3.1
  */
-bool error(unsigned short code)
+time_t timestamp(connection* c, view value)
 {
-    // ensure client's socket is open
-    if (cfd == -1)
+    char date[value.length + 1];
+    memcpy(date, c->request + value.offset, value.length);
+    date[value.length] = '\0';
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == NULL || *end != '\0')
     {
-        return false;
+        return -1;
     }
+    return timegm(&tm);
+}
 
-    // ensure code is within range
-    if (code < 400 || code > 599)
+/**
+ * Translates script's CGI headers, the first octets of body, into response's headers: Status into Status-Line
+ * (302 if there's a Location but no Status, else 200), framing into server's own (chunking content, gzipped
+ * if client accepts that and it's worth it), and the rest as they are. Returns false if they're malformed.
+ * http://tools.ietf.org/html/rfc3875#section-6
+ */
+bool translate(connection* c, size_t headers)
+{
+    // end each line in place, so that each is a string of its own
+    char* end = c->body + headers;
+    for (char* p = c->body; p < end; p++)
     {
-        return false;
+        if (*p == '\r' || *p == '\n')
+        {
+            *p = '\0';
+        }
     }
 
-    // determine Status-Line's phrase
-    // http://www.w3.org/Protocols/rfc2616/rfc2616-sec6.html#sec6.1
-    const char* phrase = NULL;
-    switch (code)
+    // find Status, Content-Type, Location and Content-Encoding, ensuring every line is a header field
+    unsigned short code = 0;
+    const char* phrase = "";
+    bool located = false;
+#ifdef HAVE_ZLIB
+    const char* type = NULL;
+    bool encoded = false;
+#endif
+    for (char* line = c->body; line < end; line += strlen(line) + 1)
     {
-        case 400: phrase = "Bad Request"; break;
-        case 403: phrase = "Forbidden"; break;
-        case 404: phrase = "Not Found"; break;
-        case 405: phrase = "Method Not Allowed"; break;
-        case 413: phrase = "Request Entity Too Large"; break;
-        case 414: phrase = "Request-URI Too Long"; break;
-        case 418: phrase = "I'm a teapot"; break;
-        case 500: phrase = "Internal Server Error"; break;
-        case 501: phrase = "Not Implemented"; break;
-        case 505: phrase = "HTTP Version Not Supported"; break;
-    }
-    if (phrase == NULL)
-    {
-        return false;
+        if (*line == '\0')
+        {
+            continue;
+        }
+        char* colon = strchr(line, ':');
+        if (colon == NULL || colon == line)
+        {
+            return false;
+        }
+        const char* value = colon + 1 + strspn(colon + 1, " \t");
+        size_t length = colon - line;
+        if (length == 6 && strncasecmp(line, "Status", 6) == 0)
+        {
+            char* rest;
+            long number = strtol(value, &rest, 10);
+            if (rest - value != 3 || number < 200 || number > 599)
+            {
+                return false;
+            }
+            code = number;
+            phrase = rest + strspn(rest, " \t");
+        }
+        else if (length == 8 && strncasecmp(line, "Location", 8) == 0)
+        {
+            located = true;
+        }
+#ifdef HAVE_ZLIB
+        else if (length == 12 && strncasecmp(line, "Content-Type", 12) == 0)
+        {
+            type = value;
+        }
+        else if (length == 16 && strncasecmp(line, "Content-Encoding", 16) == 0)
+        {
+            encoded = true;
+        }
+#endif
     }
-
-    // template
-    char* template = "<html><head><title>%i %s</title></head><body><h1>%i %s</h1></body></html>";
-    char content[strlen(template) + 2 * ((int) log10(code) + 1 - 2) + 2 * (strlen(phrase) - 2) + 1];
-    int length = sprintf(content, template, code, phrase, code, phrase);
-
-    // respond with Status-Line
-    if (dprintf(cfd, "HTTP/1.1 %i %s\r\n", code, phrase) < 0)
+    if (code == 0)
     {
-        return false;
+        code = located ? 302 : 200;
     }
 
-    // respond with Connection header
-    if (dprintf(cfd, "Connection: close\r\n") < 0)
+    // use a pre-rendered Status-Line unless script chose its own Reason-Phrase (or a Status-Code server doesn't know)
+    status* s = describe(code);
+    status custom = {.code = code, .phrase = phrase};
+    char line[sizeof("HTTP/1.1 000 \r\n") + 64];
+    if (s == NULL || (*phrase != '\0' && strcmp(phrase, s->phrase) != 0))
     {
-        return false;
+        custom.line = line;
+        custom.linelen = snprintf(line, sizeof(line), "HTTP/1.1 %i %.64s\r\n", code, phrase);
+        s = &custom;
     }
 
-    // respond with Content-Length header
-    if (dprintf(cfd, "Content-Length: %i\r\n", length) < 0)
+    // content follows, in chunks since its length isn't known yet, unless response has no message-body
+    c->chunked = code != 204 && code != 304;
+    if (!preface(c, s) || (c->chunked && !format(c, "Transfer-Encoding: chunked\r\n")))
     {
         return false;
     }
 
-    // respond with Content-Type header
-    if (dprintf(cfd, "Content-Type: text/html\r\n") < 0)
+#ifdef HAVE_ZLIB
+    // gzip content as it arrives, if client accepts that and script hasn't encoded it already
+    if (c->chunked && !encoded && compressing(c, type) && affordable())
     {
-        return false;
+        c->deflating = calloc(1, sizeof(z_stream));
+        if (c->deflating == NULL || deflateInit2(c->deflating, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            free(c->deflating);
+            c->deflating = NULL;
+            return false;
+        }
+        atomic_fetch_add_explicit(&stats[self + 1].compressions, 1, memory_order_relaxed);
+        if (!format(c, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n"))
+        {
+            return false;
+        }
     }
+#endif
 
-    // respond with CRLF
-    if (dprintf(cfd, "\r\n") < 0)
+    // pass other header fields through, save for those that frame a message, which are server's to choose
+    const char* framing[] = {"Status", "Content-Length", "Transfer-Encoding", "Connection", "Keep-Alive"};
+    for (char* line = c->body; line < end; line += strlen(line) + 1)
     {
-        return false;       
+        bool passed = *line != '\0';
+        for (size_t i = 0; i < sizeof(framing) / sizeof(framing[0]) && passed; i++)
+        {
+            size_t length = strlen(framing[i]);
+            passed = !(strncasecmp(line, framing[i], length) == 0 && line[length] == ':');
+        }
+        if (passed && !format(c, "%s\r\n", line))
+        {
+            return false;
+        }
     }
-                     
-    // respond with message-body
-    if (write(cfd, content, length) == -1)
+    if (!append(c, "\r\n", 2))
     {
         return false;
     }
-
-    // announce Response-Line
-    printf("\033[31m");
-    printf("HTTP/1.1 %i %s", code, phrase);
-    printf("\033[39m\n");
-
+    announce(s);
     return true;
 }
 
 /**
- * Loads file into message-body.
+ * Notes activity on connection, moving it to end of its worker's list of connections.
  */
-ssize_t load(void)
+void touch(connection* c)
 {
-    // ensure file is open
-    if (file == NULL)
+    worker* w = c->worker;
+    c->active = w->now;
+    if (w->last == c)
     {
-        return -1;
+        return;
     }
 
-    // ensure body isn't already loaded
-    if (body != NULL)
+    // unlink connection
+    if (c->prev != NULL)
     {
-        return -1;
+        c->prev->next = c->next;
     }
-
-    // buffer for octets
-    octet buffer[OCTETS];
-
-    // read file
-    ssize_t size = 0;
-    while (true)
+    else
     {
-        // try to read a buffer's worth of octets
-        ssize_t octets = fread(buffer, sizeof(octet), OCTETS, file); 
-
-        // check for error
-        if (ferror(file) != 0)
-        {
-            if (body != NULL)
-            {
-                free(body);
-                body = NULL;
-            }
-            return -1;
-        }
+        w->connections = c->next;
+    }
+    c->next->prev = c->prev;
 
-        // if octets were read, append to body
-        if (octets > 0)
-        {
-            body = realloc(body, size + octets); //resizing
-            if (body == NULL)                    
-            {                                    
-                return -1;                       
-            }
-            memcpy(body + size, buffer, octets); // appending
-            size += octets;
-        }
+    // append connection
+    c->prev = w->last;
+    c->next = NULL;
+    w->last->next = c;
+    w->last = c;
+}
 
-        // check for EOF
-        if (feof(file) != 0)
-        {
-            break;
-        }
-    }
-    return size;
+#ifdef HAVE_LIBURING
+/**
+ * Submits a send of connection's unsent parts of responses, all at once.
+ */
+void transmit(connection* c)
+{
+    c->message.msg_iov = c->vectors;
+    c->message.msg_iovlen = gather(c, c->vectors);
+    struct io_uring_sqe* sqe = submission(c->worker);
+    io_uring_prep_sendmsg(sqe, c->cfd, &c->message, MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, (uintptr_t) c | SEND);
+    c->inflight++;
 }
+#endif
 
+#ifdef HAVE_ZLIB
 /**
- * Handles signals.
+ * Ends connection's gzip stream, if any.
  */
-void handler(int signal)
+void seal(connection* c)
 {
-    // control-c
-    if (signal == SIGINT)
+    if (c->deflating != NULL)
     {
-        errno = 0;
-
-        // announce stop
-        printf("\033[33m");
-        printf("Stopping server\n");
-        printf("\033[39m");
-
-        // stop server
-        stop();
+        deflateEnd(c->deflating);
+        free(c->deflating);
+        c->deflating = NULL;
     }
 }
 
 /**
- * Returns MIME type for supported extensions, else NULL.
+ * Gzips octets of script's content into chunks of connection's response, flushing them so that client can
+ * decompress whatever's arrived so far (or, if finishing, ending gzip stream), accounting for time spent
+ * against compression's CPU budget. Returns false on failure.
  */
-const char* lookup(const char* extension)
+bool squeeze(connection* c, const octet* octets, size_t length, bool finishing)
 {
-    // TODO
-        
-    if (strcasecmp("css", extension) == 0)
-    {
-        return "text/css";
-    }
-    
-    if (strcasecmp("html", extension) == 0)
-    {
-        return "text/html";
-    }
-   
-    if (strcasecmp("gif", extension) == 0)
-    {
-        return "inmage/gif";
-    }
-    
-    if (strcasecmp("ico", extension) == 0)
-    {
-        return "image/x-icon";
-    }
-        
-    if (strcasecmp("jpg", extension) == 0)
-    {
-        return "image/jpeg";
-    }
-   
-    if (strcasecmp("js", extension) == 0)
-    {
-        return "text/javascript";
-    }
-    
-    if (strcasecmp("png", extension) == 0)
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    z_stream* z = c->deflating;
+    z->next_in = (Bytef*) octets;
+    z->avail_in = length;
+    uLong before = z->total_out;
+    int result;
+    do
     {
-        return "image/png";
+        octet output[OCTETS * 16];
+        z->next_out = (Bytef*) output;
+        z->avail_out = sizeof(output);
+        result = deflate(z, finishing ? Z_FINISH : Z_SYNC_FLUSH);
+        if (result == Z_STREAM_ERROR || !chunk(c, output, sizeof(output) - z->avail_out))
+        {
+            return false;
+        }
     }
-    return NULL;
+    while (finishing ? result == Z_OK : z->avail_out == 0);
+
+    // account for time spent
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    unsigned long microseconds = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    atomic_fetch_add(&spent, microseconds);
+    counters* s = &stats[self + 1];
+    atomic_fetch_add_explicit(&s->compressing, microseconds, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->uncompressed, length, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->compressed, z->total_out - before, memory_order_relaxed);
+    return !finishing || result == Z_STREAM_END;
 }
 
 /**
- * Parses an HTTP request. // it reads not from a file, but from a network connection
+ * Compresses cached file's contents into a variant of it to be cached alongside it, with validators of its own.
+ * Returns NULL if compressing file doesn't make it smaller.
  */
-ssize_t parse(void)
+entry* variant(entry* e)
 {
-    // ensure client's socket is open
-    if (cfd == -1)
+    size_t size;
+    octet* octets = gzip(e->content, e->size, &size);
+    if (octets == NULL)
     {
-        return -1;
+        return NULL;
     }
-
-    // ensure request isn't already parsed
-    if (request != NULL)
+    entry* z = create(e->path, e->type, "gzip", &e->info, size);
+    if (z != NULL)
     {
-        return -1;
+        memcpy(z->content, octets, size);
     }
+    free(octets);
+    return z;
+}
+#endif
 
-    // buffer for octets
-    octet buffer[OCTETS];
-
-    // parse request 
-    ssize_t length = 0;
+/**
+ * Invalidates cached files, and updates index, as files change, for as long as process runs.
+ */
+void* watch(void* arg __attribute__((unused)))
+{
+    octet buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
     while (true)
     {
-        // read from socket
-        ssize_t octets = read(cfd, buffer, sizeof(octet) * OCTETS);
-        if (octets == -1)
+        ssize_t length = read(nfd, buffer, sizeof(buffer));
+        if (length <= 0)
         {
-            error(500);
-            return -1;
+            errno = 0;
+            continue;
         }
-
-        // if octets have been read, remember new length
-        if (octets > 0)
+        for (octet* p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event*) p)->len)
         {
-            request = realloc(request, length + octets); 
-            if (request == NULL)
+            const struct inotify_event* event = (const struct inotify_event*) p;
+
+            // events were lost, so forget every file, indexing server's root anew
+            if (event->mask & IN_Q_OVERFLOW)
             {
-                return -1;
+                invalidate(NULL);
+                if (indexed)
+                {
+                    withdraw("", true);
+                    nftw(root, survey, 16, FTW_PHYS);
+                }
+                continue;
+            }
+            if (event->len == 0 || event->wd >= watches || watched[event->wd] == NULL)
+            {
+                continue;
             }
-            memcpy(request + length, buffer, octets); 
-            length += octets;
-        }
-        else
-        {
-            return -1;
-        }
 
-        // search for CRLF CRLF
-        int offset = (length - octets < 3) ? length - octets : 3;
-        char* haystack = request + length - octets - offset;
-        
-        // search for the needle in the haystack
-        char* needle = memmem(haystack, request + length - haystack, "\r\n\r\n", 4);
-        
-        if (needle != NULL)
-        {
-            // trim to one CRLF and null-terminate
-            length = needle - request + 2 + 1;
-            request = realloc(request, length); 
-            if (request == NULL)
+            // path of file (or directory) that changed, relative to server's root
+            char path[strlen(watched[event->wd]) + event->len + 2];
+            if (watched[event->wd][0] == '\0')
             {
-                return -1;
+                strcpy(path, event->name);
+            }
+            else
+            {
+                sprintf(path, "%s/%s", watched[event->wd], event->name);
             }
-            request[length - 1] = '\0';
-            break;
-        }
 
-        // if buffer's full and we still haven't found CRLF CRLF,
-        // then request is too large
-        if (length - 1 >= LimitRequestLine + LimitRequestFields * LimitRequestFieldSize)
-        {
-            error(413);
-            return -1;
+            // a directory changed (taking any files within it along), so forget every file,
+            // unindexing files of any directory that's gone and watching (and indexing) any that's appeared
+            if (event->mask & IN_ISDIR)
+            {
+                invalidate(NULL);
+                if (indexed && (event->mask & (IN_DELETE | IN_MOVED_FROM)))
+                {
+                    withdraw(path, true);
+                }
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    char directory[strlen(root) + strlen(path) + 2];
+                    sprintf(directory, "%s/%s", root, path);
+                    nftw(directory, survey, 16, FTW_PHYS);
+                }
+            }
+
+            // a file changed
+            else
+            {
+                invalidate(path);
+                if (indexed)
+                {
+                    refresh(path);
+                }
+            }
         }
     }
-    return length;
+    return NULL;
 }
 
 /**
- * Resets server's state, deallocating any resources.
+ * Ensures body has room for another read of script's output, doubling body whenever it fills rather than growing it
+ * a read's worth at a time.
  */
-void reset(void)
+bool widen(connection* c)
 {
-    // free response's body
-    if (body != NULL)
-    {
-        free(body);
-        body = NULL;
-    }
-
-    // close file
-    if (file != NULL)
-    {
-        fclose(file);
-        file = NULL;
-    }
-
-    // free request
-    if (request != NULL)
+    if (c->allocated - c->loaded >= OCTETS * 8)
     {
-        free(request);
-        request = NULL;
+        return true;
     }
-
-    // close client's socket
-    if (cfd != -1)
+    size_t allocated = (c->allocated == 0) ? OCTETS * 16 : c->allocated * 2;
+    octet* body = realloc(c->body, allocated);
+    if (body == NULL)
     {
-        close(cfd);
-        cfd = -1;
+        return false;
     }
+    c->body = body;
+    c->allocated = allocated;
+    return true;
 }
 
 /**
- * Starts server.
+ * Removes file at path (relative to server's root) from index, or, if path is a directory's, every file within it.
  */
-void start(short port, const char* path)
+void withdraw(const char* path, bool directory)
 {
-    // path to server's root
-    root = realpath(path, NULL);
-    if (root == NULL)
-    {
-        stop();
-    }
-
-    // ensure root exists
-    if (access(root, F_OK) == -1)
-    {
-        stop();
-    }
-
-    // ensure root is executable
-    if (access(root, X_OK) == -1)
-    {
-        stop();
-    }
-
-    // announce root
-    printf("\033[33m"); // tells bash to change the text color to brown
-    printf("Using %s for server's root", root);
-    printf("\033[39m\n"); // tells bash to stop coloring
-
-    // create a socket
-    sfd = socket(AF_INET, SOCK_STREAM, 0); // Creates the server socket
-    if (sfd == -1)
-    {
-        stop();
-    }
-
-    // allow reuse of address (to avoid "Address already in use")
-    int optval = 1;
-    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
-
-    // assign name to socket
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr)); // initiaize to 0
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port); // transform from host to network (little endian to big endian)
-    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY); // the same for the server address
-    if (bind(sfd, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) == -1) // Assigning the address to the socket.
-    {
-        stop();
-    }
+    pthread_rwlock_wrlock(&guard);
 
-    // listen for connections
-    if (listen(sfd, SOMAXCONN) == -1)
+    // vacate file's slot
+    if (!directory)
     {
-        stop();
+        record* r = probe(path);
+        if (r != NULL)
+        {
+            free(r->path);
+            r->path = vacant;
+            filed--;
+        }
     }
 
-    // announce port in use
-    struct sockaddr_in addr;
-    socklen_t addrlen = sizeof(addr);
-    if (getsockname(sfd, (struct sockaddr*) &addr, &addrlen) == -1)
+    // vacate slot of every file whose path starts with directory's (or every slot, if directory is root)
+    else
     {
-        stop();
+        size_t length = strlen(path);
+        for (size_t i = 0; i < slots; i++)
+        {
+            char* p = records[i].path;
+            if (p != NULL && p != vacant && (length == 0 || (strncmp(p, path, length) == 0 && p[length] == '/')))
+            {
+                free(p);
+                records[i].path = vacant;
+                filed--;
+            }
+        }
     }
-    printf("\033[33m");
-    printf("Listening on port %i", ntohs(addr.sin_port));
-    printf("\033[39m\n");
+    pthread_rwlock_unlock(&guard);
 }
 
 /**
- * Stop server, deallocating any resources.
+ * Runs a worker's event loop, on io_uring or epoll.
  */
-void stop(void)
+void* work(void* arg)
 {
-    // preserve errno across this function's library calls
-    int errsv = errno;
-
-    // reset server's state
-    reset();
-
-    // free root, which was allocated by realpath
-    if (root != NULL)
-    {
-        free(root);
-    }
-
-    // close server socket
-    if (sfd != -1)
-    {
-        close(sfd);
-    }
-    
-    // terminate process
-    if (errsv == 0)
-    {
-        // success
-        exit(0);
-    }
-    else
+#ifdef HAVE_LIBURING
+    if (uring)
     {
-        // announce error
-        printf("\033[33m");
-        printf("%s", strerror(errsv));
-        printf("\033[39m\n");
-
-        // failure
-        exit(1);
+        ring(arg);
+        return NULL;
     }
+#endif
+    loop(arg);
+    return NULL;
 }